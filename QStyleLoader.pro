@@ -1,10 +1,11 @@
-QT          += core widgets
+QT          += core widgets network
 TARGET      = QStyleLoader
 TEMPLATE    = lib
 CONFIG      += staticlib c++11
 
 HEADERS += \
-    qstyle_loader.h
+    qstyle_loader.h \
+    qstyle_loader_p.h
 
 SOURCES += \
     qstyle_loader.cpp
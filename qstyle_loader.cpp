@@ -1,776 +1,3876 @@
 #include "qstyle_loader.h"
+#include "qstyle_loader_p.h"
 
 #include <mutex>
+#include <atomic>
+#include <memory>
+#include <algorithm>
 
 #include <QMap>
 #include <QSet>
+#include <QHash>
+#include <QVector>
 #include <QDir>
 #include <QFile>
+#include <QColor>
 #include <QStyle>
+#include <QPalette>
 #include <QEvent>
 #include <QDebug>
 #include <QWidget>
-#include <QLayout>
 #include <QFileInfo>
+#include <QUrl>
 #include <QDateTime>
+#include <QElapsedTimer>
+#include <QRegularExpression>
 #include <QChildEvent>
-#include <QLayoutItem>
+#include <QRunnable>
+#include <QThreadPool>
 #include <QApplication>
+#include <QSharedMemory>
+#include <QCryptographicHash>
 #include <QDynamicPropertyChangeEvent>
 
+#ifdef QT_NETWORK_LIB
+#include <QtEndian>
+#include <QLocalSocket>
+#include <QLocalServer>
+#endif
+
 /*
  *
- * QStyleUpdater
+ * QStyleSheetRule
  *
  */
 
-class QStyleUpdater::_QStyleUpdater
-    : public QObject
+static QString removeComments(const QString &text)
 {
-  QStyleUpdater                   *m_root;
-  QWidget                         *m_widget;
-  bool                            m_updateChilds;
-  bool                            m_allProperties;
-  QSet<QString>                   m_properties;
-  std::function<bool(QWidget *)>  m_filter;
-  QList<QWidget*>                 m_updateList;
-  mutable std::recursive_mutex    m_locker;
-public:
-  _QStyleUpdater(QStyleUpdater *root)
-    : QObject( root )
-    , m_root( root )
-    , m_widget( nullptr )
-    , m_updateChilds( false )
-    , m_allProperties( false )
-    , m_properties()
-  {
-    startTimer( 50 );
-  }
-  ~_QStyleUpdater() override
-  {
-
+  QString result;
+  result.reserve( text.size() );
+
+  QChar quote;
+  for ( int i = 0; i < text.size(); ++i ) {
+    auto c = text.at( i );
+    if ( !quote.isNull() ) {
+      if ( c == '\\' && i + 1 < text.size() ) {
+        result += c;
+        c = text.at( ++i );
+      } else if ( c == quote ) {
+        quote = QChar();
+      }
+    } else if ( c == '"' || c == '\'' ) {
+      quote = c;
+    } else if ( c == '/' && i + 1 < text.size() && text.at( i + 1 ) == '*' ) {
+      auto end = text.indexOf( "*/", i + 2 );
+      i = end < 0 ? text.size() : end + 1;
+      continue;
+    }
+    result += c;
   }
 
-public:
-  QWidget *widget() const
-  {
-    return m_widget;
-  }
-  QStringList properties() const
-  {
-    std::lock_guard<std::recursive_mutex> locker( m_locker );
-    return m_properties.toList();
-  }
-  bool refreshChildWidgets() const
-  {
-    return m_updateChilds;
-  }
-  bool updateWithAllChanges() const
-  {
-    return m_allProperties;
-  }
+  return result;
+}
 
-public slots:
-  void reloadStyle()
-  {
-    std::lock_guard<std::recursive_mutex> locker( m_locker );
-    for ( auto w: getAllWidgets() )
-      reloadWidgetStyle( w );
+static int indexOfOutside(const QString &text, QChar symbol, int from)
+{
+  QChar quote;
+  int depth = 0;
+  for ( int i = from; i < text.size(); ++i ) {
+    auto c = text.at( i );
+    if ( !quote.isNull() ) {
+      if ( c == '\\' )
+        ++i;
+      else if ( c == quote )
+        quote = QChar();
+    } else if ( c == '"' || c == '\'' ) {
+      quote = c;
+    } else if ( c == symbol && depth == 0 ) {
+      return i;
+    } else if ( c == '(' || c == '[' ) {
+      ++depth;
+    } else if ( ( c == ')' || c == ']' ) && depth > 0 ) {
+      --depth;
+    }
   }
-  void setWidget(QWidget *widget)
-  {
-    std::lock_guard<std::recursive_mutex> locker( m_locker );
-    for ( auto w: getAllChilds() )
-      w->removeEventFilter( this );
 
-    m_widget = widget;
-    for ( auto w: getAllChilds() )
-      w->installEventFilter( this );
-  }
-  void add(const QString &property)
-  {
-    std::lock_guard<std::recursive_mutex> locker( m_locker );
-    m_properties.insert( property );
-  }
-  void remove(const QString &property)
-  {
-    std::lock_guard<std::recursive_mutex> locker( m_locker );
-    m_properties.remove( property );
-  }
-  void setProperties(const QStringList &list)
-  {
-    std::lock_guard<std::recursive_mutex> locker( m_locker );
-    m_properties.clear();
-    for ( auto &p: list )
-      m_properties.insert( p );
-  }
-  void setRefreshChildWidgets(bool enable)
-  {
-    std::lock_guard<std::recursive_mutex> locker( m_locker );
-    m_updateChilds = enable;
-  }
-  void setUpdateWithAllChanges(bool enable)
-  {
-    std::lock_guard<std::recursive_mutex> locker( m_locker );
-    m_allProperties = enable;
-  }
-  void setChildFilter(const std::function<bool(QWidget *)> &filter)
-  {
-    std::lock_guard<std::recursive_mutex> locker( m_locker );
-    m_filter = filter;
-  }
+  return -1;
+}
 
-  // Widgets methods
-private:
-  bool checkChildWidget(QWidget *child)
-  {
-    try {
-      return m_filter( child );
-    } catch (...) { }
-    return true;;
+static QStringList splitOutside(const QString &text, QChar separator)
+{
+  QStringList result;
+  int from = 0;
+  while ( from <= text.size() ) {
+    auto index = indexOfOutside( text, separator, from );
+    auto part = text.mid( from, index < 0 ? -1 : index - from ).trimmed();
+    if ( !part.isEmpty() )
+      result << part;
+    if ( index < 0 )
+      break;
+    from = index + 1;
   }
 
-  QList<QWidget*> getAllWidgets(QWidget *parent) const
-  {
-    QList<QWidget *> result;
-
-    if ( !!parent ) {
-      result << parent;
-
-
-        for ( auto child: parent->children() ) {
-          auto w = dynamic_cast<QWidget*>( child );
-          if ( !!w ) {
-            result.append( getAllWidgets( w ) );
-            continue;
-          }
+  return result;
+}
 
-          auto layout = dynamic_cast<QLayout*>( child );
-          if ( !!layout ) {
-            result.append( getAllWidgets( layout ) );
-          }
-        }
+QStyleSheetSelector::QStyleSheetSelector()
+  : exactType( false )
+  , hasAncestors( false )
+{
 
-        if ( parent->layout() )
-          result.append( getAllWidgets( parent->layout() ) );
-    }
+}
 
-    return result;
+bool QStyleSheetSelector::matches(const QObject *object) const
+{
+  if ( !type.isEmpty() ) {
+    // Namespaced classes are written as "ns--Class" in style sheets
+    auto name = QString( type ).replace( "--", "::" );
+    auto meta = object->metaObject();
+    while ( meta && name != QLatin1String( meta->className() ) )
+      meta = exactType ? nullptr : meta->superClass();
+    if ( !meta )
+      return false;
   }
 
-  QList<QWidget*> getAllWidgets(QLayout *layout) const
-  {
-    QList<QWidget*> result;
-
-    for ( int i = 0; i < layout->count(); ++i )
-      result.append( getAllWidgets( layout->itemAt( i ) ) );
+  if ( !id.isEmpty() && object->objectName() != id )
+    return false;
 
-    return result;
+  for ( auto &attribute: attributes ) {
+    auto value = object->property( attribute.first.toUtf8().constData() );
+    if ( !value.isValid() )
+      return false;
+    if ( attribute.second.isEmpty() )
+      continue;
+    if ( value.type() == QVariant::StringList
+         ? !value.toStringList().contains( attribute.second )
+         : value.toString() != attribute.second )
+      return false;
   }
 
-  QList<QWidget*> getAllWidgets(QLayoutItem *item) const
-  {
-    QList<QWidget*> result;
+  return true;
+}
 
-    if ( !!item ? !!item->widget() : false )
-      result.append( getAllWidgets( item->widget() ) );
+static QString readIdentifier(const QString &text, int &i)
+{
+  auto begin = i;
+  while ( i < text.size() && ( text.at( i ).isLetterOrNumber() || text.at( i ) == '_' || text.at( i ) == '-' ) )
+    ++i;
+  return text.mid( begin, i - begin );
+}
 
-    if ( !!item ? !!item->layout() : false )
-      result.append( getAllWidgets( item->layout() ) );
+QStyleSheetSelector QStyleSheetSelector::parse(const QString &selector)
+{
+  QStyleSheetSelector result;
+
+  // Compound selectors are separated by whitespace or ">"
+  QStringList compounds;
+  QString current;
+  QChar quote;
+  int depth = 0;
+  for ( int i = 0; i < selector.size(); ++i ) {
+    auto c = selector.at( i );
+    if ( !quote.isNull() ) {
+      current += c;
+      if ( c == '\\' && i + 1 < selector.size() )
+        current += selector.at( ++i );
+      else if ( c == quote )
+        quote = QChar();
+      continue;
+    }
 
-    return result;
+    if ( c == '"' || c == '\'' )
+      quote = c;
+    else if ( c == '[' || c == '(' )
+      ++depth;
+    else if ( ( c == ']' || c == ')' ) && depth > 0 )
+      --depth;
+
+    if ( depth == 0 && quote.isNull() && ( c.isSpace() || c == '>' ) ) {
+      if ( !current.isEmpty() )
+        compounds << current;
+      current.clear();
+    } else {
+      current += c;
+    }
   }
+  if ( !current.isEmpty() )
+    compounds << current;
 
-  QList<QWidget*> getAllWidgets() const
-  {
-    return getAllWidgets( m_widget ).toSet().toList();
-  }
+  result.hasAncestors = compounds.size() > 1;
+  auto subject = compounds.isEmpty() ? QString() : compounds.last();
 
-  QList<QObject*> getAllChilds(QObject *obj) const
-  {
-    QList<QObject *> r;
-    if ( obj ) {
-      for ( auto child: obj->children() ) {
-        r << child;
-        r.append( getAllChilds( child ) );
+  int i = 0;
+  if ( subject.startsWith( '.' ) ) {
+    result.exactType = true;
+    ++i;
+  }
+  if ( i < subject.size() && subject.at( i ) == '*' )
+    ++i;
+  else
+    result.type = readIdentifier( subject, i );
+
+  while ( i < subject.size() ) {
+    auto c = subject.at( i );
+    if ( c == '#' ) {
+      ++i;
+      result.id = readIdentifier( subject, i );
+    } else if ( c == '[' ) {
+      auto end = indexOfOutside( subject, ']', i + 1 );
+      auto content = subject.mid( i + 1, end < 0 ? -1 : end - i - 1 ).trimmed();
+      i = end < 0 ? subject.size() : end + 1;
+
+      int j = 0;
+      auto name = readIdentifier( content, j );
+      QString value;
+      auto equal = content.indexOf( '=', j );
+      if ( equal >= 0 ) {
+        value = content.mid( equal + 1 ).trimmed();
+        if ( value.size() >= 2 && ( value.startsWith( '"' ) || value.startsWith( '\'' ) ) )
+          value = value.mid( 1, value.size() - 2 );
       }
+      if ( !name.isEmpty() )
+        result.attributes << qMakePair( name, value );
+    } else if ( c == ':' && i + 1 < subject.size() && subject.at( i + 1 ) == ':' ) {
+      i += 2;
+      result.subControl = readIdentifier( subject, i );
+    } else if ( c == ':' ) {
+      ++i;
+      auto negated = i < subject.size() && subject.at( i ) == '!';
+      if ( negated )
+        ++i;
+      auto state = readIdentifier( subject, i );
+      if ( !state.isEmpty() )
+        result.pseudoStates << ( negated ? "!" + state : state );
+    } else {
+      ++i;
     }
-
-    return r;
   }
 
-  QList<QObject*> getAllChilds() const
-  {
-    return getAllChilds( m_widget ).toSet().toList();
-  }
+  return result;
+}
 
-  void reloadWidgetStyle(QWidget *widget)
-  {
-    //    qDebug() << "[STYLE] reloaded" << widget->objectName() << widget;
-    widget->style()->unpolish( widget );
-    widget->style()->polish( widget );
-    emit m_root->styleReloaded( widget );
-  }
+QString QStyleSheetRule::text() const
+{
+  QStringList items;
+  for ( auto &d: declarations )
+    items << d.first + ": " + d.second + ";";
 
-  // QObject interface
-protected:
-  bool eventFilter(QObject *watcher, QEvent *event) override
-  {
-    std::lock_guard<std::recursive_mutex> locker( m_locker );
+  return selectors.join( ", " ) + " { " + items.join( ' ' ) + " }";
+}
 
-    auto watcherWidget = qobject_cast<QWidget*>( watcher );
-    if ( !!watcherWidget )
-    {
-      // ADD CHILD
-      if ( event->type() == QEvent::Type::ChildAdded ) {
-//        qDebug() << "[ADDED] " << watcher << event;
-        auto e = dynamic_cast<QChildEvent*>( event );
-        e->child()->installEventFilter( this );
-        //        auto childWidget = qobject_cast<QWidget*>( e->child() );
-        //        if ( childWidget ) {
-        //          childWidget->installEventFilter( this );
-        //        }
-      }
-      // REMOVE CHILD
-      else if ( event->type() == QEvent::Type::ChildRemoved ) {
-//        qDebug() << "[REMOVED] " << watcher << event;
-        auto e = dynamic_cast<QChildEvent*>( event );
-        e->child()->removeEventFilter( this );
-        auto childWidget = qobject_cast<QWidget*>( e->child() );
-        if ( childWidget ) {
-          m_updateList.removeAll( childWidget );
-        }
-      }
-      // PROPERTY
-      else if ( event->type() == QEvent::Type::DynamicPropertyChange ) {
-        auto e = dynamic_cast<QDynamicPropertyChangeEvent*>( event );
+QStringList QStyleSheetRule::attributes() const
+{
+  QStringList result;
+  for ( auto &selector: selectors )
+    for ( auto &name: selectorAttributes( selector ) )
+      if ( !result.contains( name ) )
+        result << name;
 
-        // CHECK IS NOT QT PRIVATE PROPERTY
-        if ( e->propertyName().indexOf( "_q_" ) != 0  ) {
+  return result;
+}
 
-          // UPDATE CURRENT WIDGET
-          if ( watcher == m_widget && ( m_allProperties || m_properties.contains( e->propertyName() ) ) ) {
-            // reloadWidgetStyle( m_widget );
-            m_updateList.append( m_widget );
-          }
-          // UPDATE CHILD WIDGET
-          else if ( m_updateChilds && ( m_allProperties || m_properties.contains( e->propertyName() ) ) ) {
-            auto widget = qobject_cast<QWidget*>( watcher );
-            if ( checkChildWidget( widget ) ) {
-//               reloadWidgetStyle( widget );
-              m_updateList.append( widget );
-            }
-          }
-        }
-      }
+bool QStyleSheetRule::isPaintOnly() const
+{
+  for ( auto &d: declarations )
+    if ( !isPaintOnlyProperty( d.first ) )
+      return false;
+  return true;
+}
+
+bool QStyleSheetRule::isPaintOnlyProperty(const QString &name)
+{
+  // Anything that is not listed here (margins, paddings, border widths
+  // and styles, fonts, sizes, images, qproperty-*) may change geometry.
+  static const QSet<QString> properties {
+    "color",
+    "background",
+    "background-color",
+    "background-image",
+    "background-repeat",
+    "background-position",
+    "background-attachment",
+    "background-clip",
+    "background-origin",
+    "alternate-background-color",
+    "selection-color",
+    "selection-background-color",
+    "placeholder-text-color",
+    "gridline-color",
+    "border-color",
+    "border-top-color",
+    "border-right-color",
+    "border-bottom-color",
+    "border-left-color",
+    "border-radius",
+    "border-top-left-radius",
+    "border-top-right-radius",
+    "border-bottom-left-radius",
+    "border-bottom-right-radius",
+    "outline",
+    "outline-color",
+    "outline-style",
+    "outline-radius",
+    "outline-bottom-left-radius",
+    "outline-bottom-right-radius",
+    "outline-top-left-radius",
+    "outline-top-right-radius",
+    "opacity",
+    "text-decoration"
+  };
+
+  return properties.contains( name );
+}
+
+QStringList QStyleSheetRule::selectorAttributes(const QString &selector)
+{
+  QStringList result;
+  int from = 0;
+  while ( ( from = indexOfOutside( selector, '[', from ) ) >= 0 ) {
+    int i = from + 1;
+    while ( i < selector.size() && selector.at( i ).isSpace() )
+      ++i;
+
+    int begin = i;
+    while ( i < selector.size() && ( selector.at( i ).isLetterOrNumber() || selector.at( i ) == '_' || selector.at( i ) == '-' ) )
+      ++i;
+
+    if ( i > begin ) {
+      auto name = selector.mid( begin, i - begin );
+      if ( !result.contains( name ) )
+        result << name;
     }
 
-    return QObject::eventFilter( watcher, event );
+    auto end = indexOfOutside( selector, ']', i );
+    if ( end < 0 )
+      break;
+    from = end + 1;
   }
 
-  void timerEvent(QTimerEvent *event) override
-  {
-    while ( !m_updateList.isEmpty() ) {
-      QWidget *w = nullptr;
-      {
-        std::lock_guard<std::recursive_mutex> locker( m_locker );
-        w = m_updateList.takeFirst();
-      }
+  return result;
+}
 
-      if ( w )
-        reloadWidgetStyle( w );
+QList<QStyleSheetRule> QStyleSheetRule::parse(const QString &styleSheet)
+{
+  QList<QStyleSheetRule> result;
+  auto text = removeComments( styleSheet );
+
+  int from = 0;
+  while ( from < text.size() ) {
+    auto open = indexOfOutside( text, '{', from );
+    if ( open < 0 )
+      break;
+
+    auto close = indexOfOutside( text, '}', open + 1 );
+    if ( close < 0 )
+      close = text.size();
+
+    auto head = text.mid( from, open - from ).trimmed();
+    auto body = text.mid( open + 1, close - open - 1 );
+    from = close + 1;
+
+    if ( head.isEmpty() || head.startsWith( '@' ) )
+      continue;
+
+    QStyleSheetRule rule;
+    rule.selectors = splitOutside( head, ',' );
+    for ( auto &declaration: splitOutside( body, ';' ) ) {
+      auto colon = declaration.indexOf( ':' );
+      if ( colon <= 0 )
+        continue;
+      rule.declarations << qMakePair( declaration.left( colon ).trimmed().toLower(),
+                                      declaration.mid( colon + 1 ).trimmed() );
     }
-    QObject::timerEvent( event );
+
+    if ( !rule.selectors.isEmpty() )
+      result << rule;
   }
-};
 
-QStyleUpdater::QStyleUpdater(QWidget *widget, QObject *parent)
-  : QObject( parent )
-  , ptr( new _QStyleUpdater( this ) )
-{
-  setWidget( widget );
+  return result;
 }
 
-QStyleUpdater::QStyleUpdater(const QStringList &properties, QWidget *widget, QObject *parent)
-  : QObject( parent )
-  , ptr( new _QStyleUpdater( this ) )
+/*
+ *
+ * QStyleLoaderFileFilter
+ *
+ */
+
+QStyleLoaderFileFilter::QStyleLoaderFileFilter(const QStringList &include, const QStringList &exclude)
+  : m_include( include )
+  , m_exclude( exclude )
 {
-  setWidget( widget );
-  setProperties( properties );
+  compile( m_include, m_includeSuffixes, m_includeExpression );
+  compile( m_exclude, m_excludeSuffixes, m_excludeExpression );
 }
 
-QStyleUpdater::QStyleUpdater(bool updateChilds, bool allProperies, QWidget *widget, QObject *parent)
-  : QObject( parent )
-  , ptr( new _QStyleUpdater( this ) )
+QStringList QStyleLoaderFileFilter::include() const
 {
-  setWidget( widget );
-  setRefreshChildWidgets( updateChilds );
-  setUpdateWithAllChanges( allProperies );
+  return m_include;
 }
 
-QStyleUpdater::~QStyleUpdater()
+QStringList QStyleLoaderFileFilter::exclude() const
 {
-  delete ptr;
+  return m_exclude;
 }
 
-QWidget *QStyleUpdater::widget() const
+bool QStyleLoaderFileFilter::match(const QString &fileName) const
 {
-  return ptr->widget();
+  if ( !m_include.isEmpty() && !match( fileName, m_includeSuffixes, m_includeExpression ) )
+    return false;
+  return !match( fileName, m_excludeSuffixes, m_excludeExpression );
 }
 
-QStringList QStyleUpdater::properties() const
+QStringList QStyleLoaderFileFilter::files(const QString &directory) const
 {
-  return ptr->properties();
+  QStringList result;
+  QSet<QString> visited;
+  files( directory, visited, result );
+  return result;
 }
 
-bool QStyleUpdater::refreshChildWidgets() const
+void QStyleLoaderFileFilter::files(const QString &directory, QSet<QString> &visited, QStringList &result) const
 {
-  return ptr->refreshChildWidgets();
+  QDir dir ( directory );
+  auto canonical = dir.canonicalPath();
+  if ( canonical.isEmpty() || visited.contains( canonical ) )
+    return;
+  visited.insert( canonical );
+
+  for ( auto &f: dir.entryInfoList( QDir::Filter::Files ) )
+    if ( match( f.fileName() ) )
+      result << f.absoluteFilePath();
+
+  for ( auto &name: dir.entryList( QDir::Filter::Dirs | QDir::Filter::NoDotAndDotDot ) )
+    files( dir.absoluteFilePath( name ), visited, result );
 }
 
-bool QStyleUpdater::updateWithAllChanges() const
+QStringList QStyleLoaderFileFilter::defaultExclude()
 {
-  return ptr->updateWithAllChanges();
+  return QStringList {
+    "*~", "*.swp", "*.swo", "*.swx", "*.orig", "*.rej", "*.bak", "*.tmp", ".#*", "#*#"
+  };
 }
 
-void QStyleUpdater::reloadStyle()
+void QStyleLoaderFileFilter::compile(const QStringList &patterns, QStringList &suffixes, QRegularExpression &expression)
 {
-  ptr->reloadStyle();
+  static const QRegularExpression wildcards( "[*?\\[\\]]" );
+
+  QStringList expressions;
+  for ( auto &pattern: patterns ) {
+    if ( pattern.startsWith( '*' ) && !pattern.mid( 1 ).contains( wildcards ) )
+      suffixes << pattern.mid( 1 );
+    else
+      expressions << "(?:" + QRegularExpression::wildcardToRegularExpression( pattern ) + ")";
+  }
+
+  QRegularExpression::PatternOptions options = QRegularExpression::NoPatternOption;
+#ifdef Q_OS_WIN
+  options |= QRegularExpression::CaseInsensitiveOption;
+#endif
+  expression = expressions.isEmpty()
+      ? QRegularExpression()
+      : QRegularExpression( expressions.join( '|' ), options );
+  expression.optimize();
 }
 
-void QStyleUpdater::setWidget(QWidget *widget)
+bool QStyleLoaderFileFilter::match(const QString &fileName, const QStringList &suffixes, const QRegularExpression &expression)
 {
-  ptr->setWidget( widget );
+#ifdef Q_OS_WIN
+  const auto sensitivity = Qt::CaseInsensitive;
+#else
+  const auto sensitivity = Qt::CaseSensitive;
+#endif
+  for ( auto &suffix: suffixes )
+    if ( fileName.endsWith( suffix, sensitivity ) )
+      return true;
+
+  return !expression.pattern().isEmpty() && expression.match( fileName ).hasMatch();
 }
 
-void QStyleUpdater::add(const QString &property)
+/*
+ *
+ * QStyleRecord
+ *
+ */
+
+enum QStyleRecordTag : quint8
 {
-  ptr->add( property );
+  StringTag = 1,
+  EventTag  = 2
+};
+
+static const quint32 RecordMagic    = 0x51535243; // "QSRC"
+static const quint16 RecordVersion  = 1;
+
+QStyleRecordEvent::QStyleRecordEvent()
+  : usecs( 0 )
+{
+
 }
 
-void QStyleUpdater::remove(const QString &property)
+QStyleRecordWriter::QStyleRecordWriter()
+  : m_last( 0 )
 {
-  ptr->remove( property );
+
 }
 
-void QStyleUpdater::setProperties(const QStringList &list)
+QStyleRecordWriter::~QStyleRecordWriter()
 {
-  ptr->setProperties( list );
+  close();
 }
 
-void QStyleUpdater::setRefreshChildWidgets(bool enable)
+bool QStyleRecordWriter::open(const QString &fileName)
 {
-  ptr->setRefreshChildWidgets( enable );
+  close();
+  m_file.setFileName( fileName );
+  if ( !m_file.open( QFile::WriteOnly | QFile::Truncate ) )
+    return false;
+
+  m_stream.setDevice( &m_file );
+  m_stream.setVersion( QDataStream::Qt_5_6 );
+  m_stream << RecordMagic << RecordVersion;
+  m_strings.clear();
+  m_paths.clear();
+  m_last = 0;
+  m_timer.start();
+  return true;
 }
 
-void QStyleUpdater::setUpdateWithAllChanges(bool enable)
+void QStyleRecordWriter::close()
 {
-  ptr->setUpdateWithAllChanges( enable );
+  if ( m_file.isOpen() ) {
+    m_stream.setDevice( nullptr );
+    m_file.close();
+  }
 }
 
-void QStyleUpdater::setChildFilter(const std::function<bool (QWidget *)> &filter)
+bool QStyleRecordWriter::isOpen() const
 {
-  ptr->setChildFilter( filter );
+  return m_file.isOpen();
 }
 
-/*
- *
- * QStyleLoader
- *
- */
+void QStyleRecordWriter::write(const QWidget *widget, const QByteArray &property, const QVariant &value)
+{
+  if ( !m_file.isOpen() )
+    return;
+
+  // A value without stream operators would break the rest of the recording
+  auto recorded = value;
+  if ( !isStreamable( value ) ) {
+    if ( !value.canConvert<QString>() )
+      return;
+    recorded = value.toString();
+  }
 
-class QStyleLoaderGuardObserver
+  auto usecs = m_timer.nsecsElapsed() / 1000;
+  auto id = path( widget );
+  auto name = string( QString::fromUtf8( property ) );
+  m_stream << quint8( EventTag ) << qint64( usecs - m_last ) << id << name << recorded;
+  m_last = usecs;
+}
+
+QString QStyleRecordWriter::widgetPath(const QWidget *widget)
 {
-protected:
-  QStyleLoaderGuardObserver() { }
-public:
-  virtual ~QStyleLoaderGuardObserver() {}
+  QStringList segments;
+  for ( auto w = widget; w; w = w->parentWidget() ) {
+    int index = 0;
+    if ( w->parentWidget() ) {
+      for ( auto sibling: w->parentWidget()->children() ) {
+        if ( sibling == w )
+          break;
+        if ( sibling->metaObject() == w->metaObject() )
+          ++index;
+      }
+    }
 
-public:
-  virtual void added(const QString &) = 0;
-  virtual void removed(const QString &) = 0;
-  virtual void changed(const QString &) = 0;
-};
+    segments.prepend( QString::fromLatin1( QUrl::toPercentEncoding( w->metaObject()->className() ) ) + ':' +
+                      QString::fromLatin1( QUrl::toPercentEncoding( w->objectName() ) ) + ':' +
+                      QString::number( index ) );
+  }
+  return segments.join( '/' );
+}
 
-class QStyleLoaderGuard
-    : public QObject
+quint32 QStyleRecordWriter::string(const QString &text)
 {
-protected:
-  QString                   m_path;
-  QStyleLoaderGuardObserver *m_observer;
-protected:
-  QStyleLoaderGuard(const QString &path, QStyleLoaderGuardObserver *observer, QObject *parent)
-    : QObject( parent )
-    , m_path( path )
-    , m_observer( observer )
-  {
+  auto it = m_strings.find( text );
+  if ( it != m_strings.end() )
+    return it.value();
+
+  auto id = quint32( m_strings.size() );
+  m_strings.insert( text, id );
+  m_stream << quint8( StringTag ) << text;
+  return id;
+}
 
-  }
-public:
-  virtual ~QStyleLoaderGuard() override
-  {
+void QStyleRecordWriter::invalidatePaths()
+{
+  m_paths.clear();
+}
 
+quint32 QStyleRecordWriter::path(const QWidget *widget)
+{
+  // Renamed or reparented ancestors show up in the chain
+  auto it = m_paths.find( widget );
+  if ( it != m_paths.end() && it->widget == widget ) {
+    auto w = widget;
+    int i = 0;
+    for ( ; w && i < it->chain.size(); w = w->parentWidget(), ++i )
+      if ( it->chain.at( i ).first != w || it->chain.at( i ).second != w->objectName() )
+        break;
+    if ( !w && i == it->chain.size() )
+      return it->id;
   }
 
-public:
-  QString path() const
-  {
-    return m_path;
-  }
-};
+  PathEntry entry { widget, {}, string( widgetPath( widget ) ) };
+  for ( auto w = widget; w; w = w->parentWidget() )
+    entry.chain << qMakePair( w, w->objectName() );
+  m_paths.insert( widget, entry );
+  return entry.id;
+}
 
-class QStyleLoaderFileGuard final
-    : public QStyleLoaderGuard
+bool QStyleRecordWriter::isStreamable(const QVariant &value)
 {
-  QDateTime m_lastEdit;
-public:
-  QStyleLoaderFileGuard(const QString &path, QStyleLoaderGuardObserver *observer, QObject *parent)
-    : QStyleLoaderGuard( path, observer, parent )
-    , m_lastEdit( QFileInfo( path ).lastModified() )
-  {
-    startTimer( 2500 );
-  }
-  ~QStyleLoaderFileGuard() override
-  {
+  if ( !value.isValid() )
+    return true;
+
+  // Whether QMetaType can save a value depends only on its type
+  auto it = m_streamable.find( value.userType() );
+  if ( it != m_streamable.end() )
+    return it.value();
+
+  QByteArray scratch;
+  QDataStream stream ( &scratch, QIODevice::WriteOnly );
+  stream.setVersion( QDataStream::Qt_5_6 );
+  auto result = QMetaType::save( stream, value.userType(), value.constData() );
+  m_streamable.insert( value.userType(), result );
+  return result;
+}
 
-  }
+QStyleRecordReader::QStyleRecordReader()
+  : m_usecs( 0 )
+{
 
-public:
-  bool exists() const
-  {
-    return !m_lastEdit.isNull();
-  }
+}
 
-  // QObject interface
-protected:
-  void timerEvent(QTimerEvent *event) override
-  {
-    QFileInfo f ( m_path );
-    if ( f.exists() ) {
-      if ( m_lastEdit.isNull() ) {
-        m_lastEdit = f.lastModified();
-        m_observer->added( m_path );
-      } else if ( m_lastEdit != f.lastModified() ) {
-        m_lastEdit = f.lastModified();
-        m_observer->changed( m_path );
-      }
-    } else if ( !m_lastEdit.isNull() ) {
-      m_lastEdit = QDateTime();
-      m_observer->removed( m_path );
-    }
+bool QStyleRecordReader::open(const QString &fileName)
+{
+  m_file.setFileName( fileName );
+  if ( !m_file.open( QFile::ReadOnly ) )
+    return false;
 
-    QStyleLoaderGuard::timerEvent( event );
+  m_stream.setDevice( &m_file );
+  m_stream.setVersion( QDataStream::Qt_5_6 );
+  m_strings.clear();
+  m_usecs = 0;
+
+  quint32 magic = 0;
+  quint16 version = 0;
+  m_stream >> magic >> version;
+  return magic == RecordMagic && version == RecordVersion;
+}
+
+bool QStyleRecordReader::read(QStyleRecordEvent &event)
+{
+  while ( !m_stream.atEnd() && m_stream.status() == QDataStream::Ok ) {
+    quint8 tag = 0;
+    m_stream >> tag;
+
+    if ( tag == StringTag ) {
+      QString text;
+      m_stream >> text;
+      m_strings << text;
+    } else if ( tag == EventTag ) {
+      qint64 delta = 0;
+      quint32 path = 0, name = 0;
+      QVariant value;
+      m_stream >> delta >> path >> name >> value;
+      if ( m_stream.status() != QDataStream::Ok
+           || path >= quint32( m_strings.size() )
+           || name >= quint32( m_strings.size() ) )
+        return false;
+
+      m_usecs += delta;
+      event.usecs = m_usecs;
+      event.path = m_strings.at( int( path ) );
+      event.property = m_strings.at( int( name ) ).toUtf8();
+      event.value = value;
+      return true;
+    } else {
+      return false;
+    }
   }
-};
+  return false;
+}
 
-class QStyleLoaderDirectoryGuard final
-    : public QStyleLoaderGuard
+/*
+ *
+ * QStyleUpdater
+ *
+ */
+
+template<typename Stat>
+static QList<Stat> topStats(const QHash<QString, Stat> &stats, int top)
 {
-  QStringList                                 m_filter;
-  QMap<QString, QStyleLoaderFileGuard*>       m_files;
-  QMap<QString, QStyleLoaderDirectoryGuard*>  m_dirs;
+  auto result = stats.values();
+  std::sort( result.begin(), result.end(), [](const Stat &a, const Stat &b) {
+    return a.nsecs > b.nsecs;
+  });
+  return top < 0 ? result : result.mid( 0, top );
+}
+
+///
+/// Compiled form of QStyleUpdater::ChildFilter.
+///
+class QStyleUpdaterChildMatcher
+{
+  QStyleUpdater::ChildFilter                    m_filter;
+  QSet<QString>                                 m_classNames;
+  QRegularExpression                            m_objectName;
+  mutable QHash<const QMetaObject*, bool>       m_classes;
 public:
-  QStyleLoaderDirectoryGuard(const QString &path, const QStringList &filter, QStyleLoaderGuardObserver *observer, QObject *parent)
-    : QStyleLoaderGuard( path, observer, parent )
-    , m_filter( filter )
-  {
-    startTimer( 10000 );
-  }
-  ~QStyleLoaderDirectoryGuard() override
+  QStyleUpdaterChildMatcher(const QStyleUpdater::ChildFilter &filter = QStyleUpdater::ChildFilter())
+    : m_filter( filter )
   {
-    while ( m_dirs.isEmpty() )
-      delete m_dirs.take( m_dirs.firstKey() );
-
-    while ( m_files.isEmpty() )
-      delete m_files.take( m_files.firstKey() );
+    for ( auto &name: filter.classNames )
+      m_classNames.insert( name );
+
+    if ( !filter.objectNamePattern.isEmpty() )
+      m_objectName.setPattern( filter.regularExpression
+                               ? filter.objectNamePattern
+                               : QRegularExpression::wildcardToRegularExpression( filter.objectNamePattern ) );
+    m_objectName.optimize();
+
+    // An invalid pattern matches no child at all
+    if ( !filter.objectNamePattern.isEmpty() && !m_objectName.isValid() )
+      qWarning() << "QStyleUpdater: invalid object name pattern" << filter.objectNamePattern
+                 << "of the child filter:" << m_objectName.errorString()
+                 << "at offset" << m_objectName.patternErrorOffset();
   }
 
-public:
-  QStringList filter() const
+  QStyleUpdater::ChildFilter filter() const
   {
     return m_filter;
   }
 
-  void setFilter(const QStringList &filter)
+  bool isEmpty() const
   {
-    m_filter = filter;
-    for ( auto &d: m_dirs.values() )
-      d->setFilter( filter );
-
-    updateEntries();
+    return m_classNames.isEmpty()
+        && m_filter.objectNamePattern.isEmpty()
+        && m_filter.requiredProperty.isEmpty()
+        && m_filter.maxDepth < 0;
   }
 
-private slots:
-  void updateEntries()
+  bool match(const QWidget *child, const QWidget *root) const
   {
-    QSet<QString> files, dirs;
-    QDir directory( QDir::fromNativeSeparators( m_path ) );
-    for ( auto file: directory.entryInfoList( m_filter, QDir::Files ) )
-      files.insert( file.absoluteFilePath() );
-
-    for ( auto name: directory.entryList( QDir::Dirs ) ) {
-      if ( name == ".." ) continue;
-      dirs.insert( directory.absoluteFilePath( name ) );
-    }
+    if ( !m_classNames.isEmpty() && !matchClass( child->metaObject() ) )
+      return false;
 
-    for ( auto &file: files ) {
-      if ( !m_files.contains( file ) ) {
-        m_files[ file ] = new QStyleLoaderFileGuard( file, m_observer, this );
-        m_observer->added( file );
-      }
-    }
+    if ( !m_filter.objectNamePattern.isEmpty() && !m_objectName.match( child->objectName() ).hasMatch() )
+      return false;
 
-    for ( auto &file: m_files.keys() ) {
-      if ( !files.contains( file ) ) {
-        auto obj = m_files[ file ];
-        m_files.remove( file );
-        delete obj;
+    if ( !m_filter.requiredProperty.isEmpty() && !child->property( m_filter.requiredProperty.constData() ).isValid() )
+      return false;
 
-        m_observer->removed( file );
-      }
+    if ( m_filter.maxDepth >= 0 ) {
+      int depth = 0;
+      for ( auto w = child; w && w != root; w = w->parentWidget() )
+        if ( ++depth > m_filter.maxDepth )
+          return false;
     }
 
-    for ( auto &dir: dirs )
-      if ( !m_dirs.contains( dir ) )
-        m_dirs[ dir ] = new QStyleLoaderDirectoryGuard( dir, m_filter, m_observer, this );
+    return true;
+  }
 
-    for ( auto &dir: m_dirs.keys() ) {
-      if ( !dirs.contains( dir ) ) {
-        auto obj = m_dirs[ dir ];
-        m_dirs.remove( dir );
-        obj->deactivate();
-        delete obj;
-      }
-    }
+private:
+  bool matchClass(const QMetaObject *meta) const
+  {
+    auto it = m_classes.find( meta );
+    if ( it != m_classes.end() )
+      return it.value();
+
+    auto result = false;
+    for ( auto m = meta; m && !result; m = m->superClass() )
+      result = m_classNames.contains( QString::fromLatin1( m->className() ) );
+    m_classes.insert( meta, result );
+    return result;
   }
+};
 
-  void deactivate()
+///
+/// Settings of an updater. Configurations of profiles are never changed,
+/// a profile change replaces the whole configuration in its holder.
+///
+struct QStyleUpdaterConfig
+{
+  QSet<QString>                   properties;
+  bool                            updateChilds;
+  bool                            allProperties;
+  std::function<bool(QWidget *)>  filter;
+  QStyleUpdaterChildMatcher       matcher;
+  int                             budget;
+
+  QStyleUpdaterConfig()
+    : updateChilds( false )
+    , allProperties( false )
+    , budget( 0 )
   {
-    for ( auto dir: m_dirs.values() )
-      dir->deactivate();
 
-    for ( auto file: m_files.values() )
-      if ( file->exists() )
-        m_observer->removed( file->path() );
+  }
+  explicit QStyleUpdaterConfig(const QStyleUpdater::Profile &profile)
+    : updateChilds( profile.refreshChildWidgets )
+    , allProperties( profile.updateWithAllChanges )
+    , filter( profile.filter )
+    , matcher( profile.childFilter )
+    , budget( qMax( 0, profile.repolishBudget ) )
+  {
+    for ( auto &p: profile.properties )
+      properties.insert( p );
   }
 
-  // QObject interface
-protected:
-  void timerEvent(QTimerEvent *event) override
+  QStyleUpdater::Profile profile() const
   {
-    updateEntries();
-    QStyleLoaderGuard::timerEvent( event );
+    QStyleUpdater::Profile result;
+    result.properties = properties.toList();
+    result.refreshChildWidgets = updateChilds;
+    result.updateWithAllChanges = allProperties;
+    result.childFilter = matcher.filter();
+    result.filter = filter;
+    result.repolishBudget = budget;
+    return result;
   }
 };
 
-class QStyleLoader::_QStyleLoader
+///
+/// Configuration shared by the updaters of one profile.
+///
+struct QStyleUpdaterConfigHolder
+{
+  QString                               profile;
+  std::shared_ptr<QStyleUpdaterConfig>  config;
+};
+
+static std::shared_ptr<QStyleUpdaterConfigHolder> defaultConfigHolder()
+{
+  static auto holder = std::make_shared<QStyleUpdaterConfigHolder>(
+        QStyleUpdaterConfigHolder { QString(), std::make_shared<QStyleUpdaterConfig>() } );
+  return holder;
+}
+
+static QString statKey(const QWidget *widget)
+{
+  return QString::fromLatin1( widget->metaObject()->className() ) + '#' + widget->objectName();
+}
+
+class QStyleUpdater::_QStyleUpdater
     : public QObject
-    , public QStyleLoaderGuardObserver
 {
-  QStyleLoader                      *m_root;
-  bool                              m_autoReload;
-  bool                              m_hasReload;
-  QDateTime                         m_lastReloaded;
-  QList<Item>                       m_items;
-  QStringList                       m_filter;
-  QList<QStyleUpdater*>             m_updaters;
-  QMap<QString, QStyleLoaderGuard*> m_guards;
-  mutable std::recursive_mutex  m_locker;
+  struct PostedProperty
+  {
+    QPointer<QWidget> widget;
+    QByteArray        name;
+    QVariant          value;
+    PostedProperty    *next;
+  };
+
+  QStyleUpdater                   *m_root;
+  QWidget                         *m_widget;
+  std::shared_ptr<QStyleUpdaterConfigHolder>  m_config;
+  QSet<QString>                   m_paintOnlyProperties;
+  QList<QWidget*>                 m_updateList;
+  QList<QWidget*>                 m_batchList;
+  QHash<QWidget*, QSet<QString>>  m_changedProperties;
+  QHash<QWidget*, QVariantHash>   m_polishedValues;
+  QVector<QWidget*>               m_index;
+  QHash<QWidget*, int>            m_indexPositions;
+  int                             m_batchDepth;
+  QHash<QWidget*, bool>           m_scheduled;
+  QList<QWidget*>                 m_visibleQueue;
+  QList<QWidget*>                 m_hiddenQueue;
+  int                             m_flushTimer;
+  int                             m_sliceTimer;
+  bool                            m_profiling;
+  QHash<QString, PolishStat>      m_stats;
+  QStyleRecordWriter              m_recorder;
+  std::atomic<PostedProperty*>    m_posted;
+  mutable std::recursive_mutex    m_locker;
 public:
-  _QStyleLoader(QStyleLoader *root)
+  _QStyleUpdater(QStyleUpdater *root)
     : QObject( root )
     , m_root( root )
-    , m_autoReload( true )
-    , m_hasReload( false )
+    , m_widget( nullptr )
+    , m_config( defaultConfigHolder() )
+    , m_batchDepth( 0 )
+    , m_flushTimer( 0 )
+    , m_sliceTimer( 0 )
+    , m_profiling( false )
+    , m_posted( nullptr )
   {
-    startTimer( 2000 );
+
   }
-  ~_QStyleLoader() override
+  ~_QStyleUpdater() override
   {
-
+    auto item = m_posted.exchange( nullptr );
+    while ( item ) {
+      auto next = item->next;
+      delete item;
+      item = next;
+    }
   }
 
 public:
-  int count() const
+  QWidget *widget() const
   {
-    return m_items.count();
+    return m_widget;
   }
-  Item at(int index) const
+  QStringList properties() const
   {
     std::lock_guard<std::recursive_mutex> locker( m_locker );
-    return index >= 0 && index < m_items.count()
-        ? m_items.at( index )
-        : Item();
+    return config().properties.toList();
   }
-  QList<Item> items() const
+  bool refreshChildWidgets() const
   {
-    return m_items;
+    return config().updateChilds;
   }
-  QStringList fileFilters() const
+  bool updateWithAllChanges() const
   {
-    return m_filter;
+    return config().allProperties;
   }
-
-  bool contains(const QString &path) const
+  QStringList paintOnlyProperties() const
   {
     std::lock_guard<std::recursive_mutex> locker( m_locker );
-    for ( auto &item: m_items )
-      if ( item.path == path )
-        return true;
-    return false;
+    return m_paintOnlyProperties.toList();
   }
-  bool containsFile(const QString &path) const
+  ChildFilter childFilter() const
   {
     std::lock_guard<std::recursive_mutex> locker( m_locker );
-    for ( auto &item: m_items )
-      if ( item.type == Item::Type::File && item.path == path )
-        return true;
-    return false;
+    return config().matcher.filter();
   }
-  bool containsDirectory(const QString &path) const
+  QString profileName() const
   {
     std::lock_guard<std::recursive_mutex> locker( m_locker );
-    for ( auto &item: m_items )
-      if ( item.type == Item::Type::Directory && item.path == path )
-        return true;
-    return false;
+    return m_config->profile;
+  }
+  Profile profile() const
+  {
+    std::lock_guard<std::recursive_mutex> locker( m_locker );
+    return config().profile();
   }
 
-  QList<QStyleUpdater*> updaters() const
+  int repolishBudget() const
   {
-    return m_updaters;
+    return config().budget;
   }
-  bool containsUpdater(QWidget *widget) const
+  bool isRepolishing() const
   {
     std::lock_guard<std::recursive_mutex> locker( m_locker );
-    for ( auto updater: m_updaters )
-      if ( updater->widget() == widget )
-        return true;
-    return false;
+    return !m_scheduled.isEmpty();
   }
-  QStyleUpdater *updater(QWidget *widget) const
+
+  bool isBatchActive() const
+  {
+    return m_batchDepth > 0;
+  }
+  void beginBatch()
   {
     std::lock_guard<std::recursive_mutex> locker( m_locker );
-    for ( auto updater: m_updaters )
-      if ( updater->widget() == widget )
-        return updater;
-    return nullptr;
+    ++m_batchDepth;
+  }
+  void endBatch()
+  {
+    QList<QWidget*> widgets;
+    {
+      std::lock_guard<std::recursive_mutex> locker( m_locker );
+      if ( m_batchDepth == 0 || --m_batchDepth > 0 )
+        return;
+      widgets.swap( m_batchList );
+    }
+
+    for ( auto w: widgets ) {
+      if ( config().budget > 0 )
+        schedule( w, false );
+      else
+        flushWidget( w );
+    }
   }
 
-  bool autoReloadStyle() const
+  void postProperty(QWidget *widget, const QByteArray &name, const QVariant &value)
   {
-    return m_autoReload;
+    // The guard is created here, the widget must outlive this call
+    auto item = new PostedProperty { widget, name, value, nullptr };
+    auto head = m_posted.load( std::memory_order_relaxed );
+    do {
+      item->next = head;
+    } while ( !m_posted.compare_exchange_weak( head, item,
+                                               std::memory_order_release,
+                                               std::memory_order_relaxed ) );
+
+    // The first item of an empty queue wakes the thread of the updater
+    if ( !head )
+      QMetaObject::invokeMethod( this, [this]() { applyPostedProperties(); }, Qt::QueuedConnection );
+  }
+
+  bool polishProfiling() const
+  {
+    return m_profiling;
+  }
+  QList<PolishStat> polishStats(int top) const
+  {
+    std::lock_guard<std::recursive_mutex> locker( m_locker );
+    return topStats( m_stats, top );
+  }
+  void clearPolishStats()
+  {
+    std::lock_guard<std::recursive_mutex> locker( m_locker );
+    m_stats.clear();
+  }
+
+  bool isRecording() const
+  {
+    std::lock_guard<std::recursive_mutex> locker( m_locker );
+    return m_recorder.isOpen();
+  }
+  bool startRecording(const QString &fileName)
+  {
+    std::lock_guard<std::recursive_mutex> locker( m_locker );
+    return m_recorder.open( fileName );
+  }
+  void stopRecording()
+  {
+    std::lock_guard<std::recursive_mutex> locker( m_locker );
+    m_recorder.close();
   }
+
 public slots:
-  void add(Item::Type type, const QString &path)
+  void reloadStyle()
   {
     std::lock_guard<std::recursive_mutex> locker( m_locker );
-    if ( type == Item::Type::File )
-      addFile( path );
-    else
-      addDirectory( path );
+    // Handlers of styleReloaded may delete widgets, which swap-removes them
+    // from the index, so a copy is walked and removed widgets are skipped
+    auto widgets = m_index;
+    for ( auto w: widgets ) {
+      if ( !m_indexPositions.contains( w ) )
+        continue;
+      rememberValues( w );
+      if ( config().budget > 0 )
+        schedule( w, true );
+      else
+        reloadWidgetStyle( w );
+    }
+
+    if ( config().budget == 0 )
+      emit m_root->repolishFinished();
+  }
+  void setWidget(QWidget *widget)
+  {
+    std::lock_guard<std::recursive_mutex> locker( m_locker );
+    if ( m_widget ) {
+      disconnect( m_widget, nullptr, this, nullptr );
+      unindex( m_widget );
+    }
+
+    m_polishedValues.clear();
+    m_index.clear();
+    m_indexPositions.clear();
+    clearSchedule();
+
+    m_widget = widget;
+    if ( m_widget ) {
+      index( m_widget );
+      connect( m_widget, &QObject::destroyed, this, [this]() {
+        std::lock_guard<std::recursive_mutex> locker( m_locker );
+        forget( m_widget );
+        m_widget = nullptr;
+        m_index.clear();
+        m_indexPositions.clear();
+        clearSchedule();
+      });
+    }
+  }
+  void add(const QString &property)
+  {
+    std::lock_guard<std::recursive_mutex> locker( m_locker );
+    if ( !config().properties.contains( property ) )
+      detach().properties.insert( property );
+  }
+  void remove(const QString &property)
+  {
+    std::lock_guard<std::recursive_mutex> locker( m_locker );
+    if ( config().properties.contains( property ) )
+      detach().properties.remove( property );
+  }
+  void setProperties(const QStringList &list)
+  {
+    std::lock_guard<std::recursive_mutex> locker( m_locker );
+    auto &properties = detach().properties;
+    properties.clear();
+    for ( auto &p: list )
+      properties.insert( p );
+  }
+  void setRefreshChildWidgets(bool enable)
+  {
+    std::lock_guard<std::recursive_mutex> locker( m_locker );
+    if ( config().updateChilds != enable )
+      detach().updateChilds = enable;
+  }
+  void setUpdateWithAllChanges(bool enable)
+  {
+    std::lock_guard<std::recursive_mutex> locker( m_locker );
+    if ( config().allProperties != enable )
+      detach().allProperties = enable;
+  }
+  void setChildFilter(const std::function<bool(QWidget *)> &filter)
+  {
+    std::lock_guard<std::recursive_mutex> locker( m_locker );
+    detach().filter = filter;
+  }
+  void setChildFilter(const ChildFilter &filter)
+  {
+    std::lock_guard<std::recursive_mutex> locker( m_locker );
+    detach().matcher = QStyleUpdaterChildMatcher( filter );
+  }
+  void setPaintOnlyProperties(const QStringList &list)
+  {
+    std::lock_guard<std::recursive_mutex> locker( m_locker );
+    m_paintOnlyProperties.clear();
+    for ( auto &p: list )
+      m_paintOnlyProperties.insert( p );
+  }
+  void setPolishProfiling(bool enable)
+  {
+    std::lock_guard<std::recursive_mutex> locker( m_locker );
+    m_profiling = enable;
+  }
+  void setRepolishBudget(int msecs)
+  {
+    std::lock_guard<std::recursive_mutex> locker( m_locker );
+    msecs = qMax( 0, msecs );
+    if ( config().budget != msecs )
+      detach().budget = msecs;
+    if ( msecs == 0 && m_sliceTimer )
+      repolishSlice();
+  }
+
+  ///
+  /// Switches the updater to a shared configuration, used by the loader for profiles.
+  ///
+  void setConfig(const std::shared_ptr<QStyleUpdaterConfigHolder> &holder)
+  {
+    std::lock_guard<std::recursive_mutex> locker( m_locker );
+    m_config = holder;
+    configChanged();
+  }
+
+  ///
+  /// Queued slices are flushed when the configuration no longer has a budget
+  ///
+  void configChanged()
+  {
+    std::lock_guard<std::recursive_mutex> locker( m_locker );
+    if ( config().budget == 0 && m_sliceTimer )
+      repolishSlice();
+  }
+
+  // Config methods
+private:
+  const QStyleUpdaterConfig &config() const
+  {
+    return *m_config->config;
+  }
+
+  ///
+  /// Copy on write: a shared configuration is copied before the first change,
+  /// so the updater leaves its profile and keeps the rest of the settings.
+  ///
+  QStyleUpdaterConfig &detach()
+  {
+    if ( m_config.use_count() > 1 ) {
+      auto holder = std::make_shared<QStyleUpdaterConfigHolder>();
+      holder->config = std::make_shared<QStyleUpdaterConfig>( config() );
+      m_config = holder;
+    }
+    m_config->profile.clear();
+    return *m_config->config;
+  }
+
+  // Widgets methods
+private:
+  bool checkChildWidget(QWidget *child)
+  {
+    // The filter may change the profile, the configuration is kept alive
+    auto config = m_config->config;
+    if ( !config->matcher.isEmpty() && !config->matcher.match( child, m_widget ) )
+      return false;
+    if ( !config->filter )
+      return true;
+
+    try {
+      return config->filter( child );
+    } catch (...) { }
+    return true;
+  }
+
+  ///
+  /// The updater keeps the widgets of its tree in a flat index, which is
+  /// updated from the ChildAdded and ChildRemoved events it already filters.
+  ///
+  void index(QObject *obj)
+  {
+    obj->installEventFilter( this );
+    if ( obj->isWidgetType() ) {
+      auto w = static_cast<QWidget*>( obj );
+      if ( !m_indexPositions.contains( w ) ) {
+        m_indexPositions.insert( w, m_index.size() );
+        m_index.append( w );
+      }
+    }
+
+    for ( auto child: obj->children() )
+      index( child );
+  }
+
+  void unindex(QObject *obj)
+  {
+    obj->removeEventFilter( this );
+    // A child being destroyed is no longer a QWidget for qobject_cast,
+    // but it still is a widget type, so its queued entries are dropped here
+    if ( obj->isWidgetType() ) {
+      auto w = static_cast<QWidget*>( obj );
+      forget( w );
+      auto it = m_indexPositions.find( w );
+      if ( it != m_indexPositions.end() ) {
+        auto position = it.value();
+        auto last = m_index.last();
+        m_index[ position ] = last;
+        m_indexPositions[ last ] = position;
+        m_index.removeLast();
+        m_indexPositions.remove( w );
+      }
+    }
+
+    for ( auto child: obj->children() )
+      unindex( child );
+  }
+
+  void forget(QWidget *widget)
+  {
+    // Queued entries of the widget are skipped by the next slice
+    m_scheduled.remove( widget );
+    m_updateList.removeAll( widget );
+    m_batchList.removeAll( widget );
+    m_changedProperties.remove( widget );
+    m_polishedValues.remove( widget );
+  }
+
+  void applyPostedProperties()
+  {
+    auto item = m_posted.exchange( nullptr, std::memory_order_acquire );
+    if ( !item )
+      return;
+
+    // The queue is a stack, so the first item
+    // of each property holds the latest value
+    QVector<PostedProperty*> latest;
+    QSet<QPair<QWidget*, QByteArray>> keys;
+    while ( item ) {
+      auto next = item->next;
+      auto key = qMakePair( item->widget.data(), item->name );
+      if ( item->widget && !keys.contains( key ) ) {
+        keys.insert( key );
+        latest << item;
+      } else {
+        delete item;
+      }
+      item = next;
+    }
+
+    beginBatch();
+    for ( int i = latest.size() - 1; i >= 0; --i ) {
+      item = latest.at( i );
+      if ( item->widget )
+        item->widget->setProperty( item->name.constData(), item->value );
+      delete item;
+    }
+    endBatch();
+  }
+
+  void record(QWidget *widget, const QByteArray &property)
+  {
+    if ( m_recorder.isOpen() )
+      m_recorder.write( widget, property, widget->property( property.constData() ) );
+  }
+
+  void queueWidget(QWidget *widget, const QString &property)
+  {
+    auto it = m_changedProperties.find( widget );
+    if ( it == m_changedProperties.end() ) {
+      it = m_changedProperties.insert( widget, QSet<QString>() );
+      if ( m_batchDepth > 0 ) {
+        m_batchList.append( widget );
+      } else {
+        // The flush timer only runs while widgets are queued
+        m_updateList.append( widget );
+        if ( !m_flushTimer )
+          m_flushTimer = startTimer( 50 );
+      }
+    }
+    it->insert( property );
+  }
+
+  ///
+  /// Takes the queued properties of the widget and compares them with
+  /// the values the widget was polished with. Returns false when nothing
+  /// has effectively changed (e.g. the value went A -> B -> A).
+  ///
+  bool takeChanges(QWidget *widget, bool &relayout)
+  {
+    std::lock_guard<std::recursive_mutex> locker( m_locker );
+    auto changed = false;
+    auto &values = m_polishedValues[ widget ];
+    relayout = false;
+
+    for ( auto &p: m_changedProperties.take( widget ) ) {
+      auto value = widget->property( p.toUtf8().constData() );
+      auto it = values.find( p );
+      if ( it != values.end() && *it == value )
+        continue;
+
+      values[ p ] = value;
+      changed = true;
+      if ( !m_paintOnlyProperties.contains( p ) )
+        relayout = true;
+    }
+
+    return changed;
+  }
+
+  void rememberValues(QWidget *widget)
+  {
+    auto &values = m_polishedValues[ widget ];
+    if ( config().allProperties ) {
+      for ( auto &name: widget->dynamicPropertyNames() )
+        if ( name.indexOf( "_q_" ) != 0 )
+          values[ QString::fromUtf8( name ) ] = widget->property( name.constData() );
+    } else {
+      for ( auto &p: config().properties )
+        values[ p ] = widget->property( p.toUtf8().constData() );
+    }
+  }
+
+  void flushWidget(QWidget *widget)
+  {
+    auto relayout = false;
+    if ( takeChanges( widget, relayout ) )
+      reloadWidgetStyle( widget, relayout );
+  }
+
+  ///
+  /// Widgets waiting for a repolish slice. The value forces a full
+  /// reload, otherwise only the changed properties are checked.
+  ///
+  void schedule(QWidget *widget, bool full)
+  {
+    auto it = m_scheduled.find( widget );
+    if ( it != m_scheduled.end() ) {
+      it.value() = it.value() || full;
+      return;
+    }
+
+    m_scheduled.insert( widget, full );
+    ( widget->isVisible() ? m_visibleQueue : m_hiddenQueue ).append( widget );
+    if ( !m_sliceTimer )
+      m_sliceTimer = startTimer( 0 );
+  }
+
+  void clearSchedule()
+  {
+    m_scheduled.clear();
+    m_visibleQueue.clear();
+    m_hiddenQueue.clear();
+    if ( m_sliceTimer ) {
+      killTimer( m_sliceTimer );
+      m_sliceTimer = 0;
+    }
+  }
+
+  void repolishScheduled(QWidget *widget)
+  {
+    auto it = m_scheduled.find( widget );
+    if ( it == m_scheduled.end() )
+      return;
+
+    auto full = it.value();
+    m_scheduled.erase( it );
+    if ( full ) {
+      m_changedProperties.remove( widget );
+      reloadWidgetStyle( widget );
+    } else {
+      flushWidget( widget );
+    }
+  }
+
+  void repolishSlice()
+  {
+    std::lock_guard<std::recursive_mutex> locker( m_locker );
+    QElapsedTimer timer;
+    timer.start();
+
+    auto focus = QApplication::focusWidget();
+    if ( focus )
+      repolishScheduled( focus );
+
+    while ( !m_visibleQueue.isEmpty() || !m_hiddenQueue.isEmpty() ) {
+      auto &queue = m_visibleQueue.isEmpty() ? m_hiddenQueue : m_visibleQueue;
+      repolishScheduled( queue.takeFirst() );
+      if ( config().budget > 0 && timer.nsecsElapsed() >= config().budget * 1000000LL )
+        return;
+    }
+
+    killTimer( m_sliceTimer );
+    m_sliceTimer = 0;
+    m_scheduled.clear();
+    emit m_root->repolishFinished();
+  }
+
+  void reloadWidgetStyle(QWidget *widget, bool relayout = true)
+  {
+    //    qDebug() << "[STYLE] reloaded" << widget->objectName() << widget;
+    QElapsedTimer timer;
+    if ( m_profiling )
+      timer.start();
+
+    if ( relayout ) {
+      widget->style()->unpolish( widget );
+      widget->style()->polish( widget );
+    } else {
+      // Polishing drops the cached rules of the widget, unpolish would
+      // also reset its size constraints and force a new layout pass.
+      widget->style()->polish( widget );
+      widget->update();
+    }
+
+    if ( m_profiling ) {
+      auto nsecs = timer.nsecsElapsed();
+      addPolishStat( widget, nsecs );
+      emit m_root->styleProfiled( widget, nsecs );
+    }
+    emit m_root->styleReloaded( widget );
+  }
+
+  void addPolishStat(QWidget *widget, qint64 nsecs)
+  {
+    std::lock_guard<std::recursive_mutex> locker( m_locker );
+    auto &stat = m_stats[ statKey( widget ) ];
+    if ( stat.count == 0 ) {
+      stat.className = QString::fromLatin1( widget->metaObject()->className() );
+      stat.objectName = widget->objectName();
+    }
+    ++stat.count;
+    stat.nsecs += nsecs;
+  }
+
+  // QObject interface
+protected:
+  bool eventFilter(QObject *watcher, QEvent *event) override
+  {
+    std::lock_guard<std::recursive_mutex> locker( m_locker );
+
+    auto watcherWidget = qobject_cast<QWidget*>( watcher );
+    if ( !!watcherWidget )
+    {
+      // ADD CHILD
+      if ( event->type() == QEvent::Type::ChildAdded ) {
+//        qDebug() << "[ADDED] " << watcher << event;
+        auto e = dynamic_cast<QChildEvent*>( event );
+        index( e->child() );
+        m_recorder.invalidatePaths();
+      }
+      // REMOVE CHILD
+      else if ( event->type() == QEvent::Type::ChildRemoved ) {
+//        qDebug() << "[REMOVED] " << watcher << event;
+        auto e = dynamic_cast<QChildEvent*>( event );
+        unindex( e->child() );
+        m_recorder.invalidatePaths();
+      }
+      // PROPERTY
+      else if ( event->type() == QEvent::Type::DynamicPropertyChange ) {
+        auto e = dynamic_cast<QDynamicPropertyChangeEvent*>( event );
+
+        // CHECK IS NOT QT PRIVATE PROPERTY
+        if ( e->propertyName().indexOf( "_q_" ) != 0  ) {
+          auto tracked = config().allProperties || config().properties.contains( e->propertyName() );
+
+          // UPDATE CURRENT WIDGET
+          if ( watcher == m_widget && tracked ) {
+            // reloadWidgetStyle( m_widget );
+            record( m_widget, e->propertyName() );
+            queueWidget( m_widget, e->propertyName() );
+          }
+          // UPDATE CHILD WIDGET
+          else if ( config().updateChilds && tracked ) {
+            auto widget = qobject_cast<QWidget*>( watcher );
+            if ( checkChildWidget( widget ) ) {
+//               reloadWidgetStyle( widget );
+              record( widget, e->propertyName() );
+              queueWidget( widget, e->propertyName() );
+            }
+          }
+        }
+      }
+    }
+
+    return QObject::eventFilter( watcher, event );
+  }
+
+  void timerEvent(QTimerEvent *event) override
+  {
+    if ( event->timerId() == m_sliceTimer ) {
+      repolishSlice();
+    } else if ( event->timerId() == m_flushTimer ) {
+      while ( !m_updateList.isEmpty() ) {
+        QWidget *w = nullptr;
+        {
+          std::lock_guard<std::recursive_mutex> locker( m_locker );
+          w = m_updateList.takeFirst();
+        }
+
+        if ( !w )
+          continue;
+        if ( config().budget > 0 )
+          schedule( w, false );
+        else
+          flushWidget( w );
+      }
+
+      std::lock_guard<std::recursive_mutex> locker( m_locker );
+      if ( m_updateList.isEmpty() ) {
+        killTimer( m_flushTimer );
+        m_flushTimer = 0;
+      }
+    }
+    QObject::timerEvent( event );
+  }
+};
+
+QStyleUpdater::PolishStat::PolishStat()
+  : count( 0 )
+  , nsecs( 0 )
+{
+
+}
+
+QStyleUpdater::ChildFilter::ChildFilter()
+  : regularExpression( false )
+  , maxDepth( -1 )
+{
+
+}
+
+QStyleUpdater::Profile::Profile()
+  : refreshChildWidgets( false )
+  , updateWithAllChanges( false )
+  , repolishBudget( 0 )
+{
+
+}
+
+QStyleUpdater::Batch::Batch(QStyleUpdater *updater)
+  : m_updater( updater )
+{
+  if ( m_updater )
+    m_updater->beginBatch();
+}
+
+QStyleUpdater::Batch::~Batch()
+{
+  if ( m_updater )
+    m_updater->endBatch();
+}
+
+QStyleUpdater::QStyleUpdater(QWidget *widget, QObject *parent)
+  : QObject( parent )
+  , ptr( new _QStyleUpdater( this ) )
+{
+  setWidget( widget );
+}
+
+QStyleUpdater::QStyleUpdater(const QStringList &properties, QWidget *widget, QObject *parent)
+  : QObject( parent )
+  , ptr( new _QStyleUpdater( this ) )
+{
+  setWidget( widget );
+  setProperties( properties );
+}
+
+QStyleUpdater::QStyleUpdater(bool updateChilds, bool allProperies, QWidget *widget, QObject *parent)
+  : QObject( parent )
+  , ptr( new _QStyleUpdater( this ) )
+{
+  setWidget( widget );
+  setRefreshChildWidgets( updateChilds );
+  setUpdateWithAllChanges( allProperies );
+}
+
+QStyleUpdater::~QStyleUpdater()
+{
+  delete ptr;
+}
+
+QWidget *QStyleUpdater::widget() const
+{
+  return ptr->widget();
+}
+
+QStringList QStyleUpdater::properties() const
+{
+  return ptr->properties();
+}
+
+bool QStyleUpdater::refreshChildWidgets() const
+{
+  return ptr->refreshChildWidgets();
+}
+
+bool QStyleUpdater::updateWithAllChanges() const
+{
+  return ptr->updateWithAllChanges();
+}
+
+QStringList QStyleUpdater::paintOnlyProperties() const
+{
+  return ptr->paintOnlyProperties();
+}
+
+QStyleUpdater::ChildFilter QStyleUpdater::childFilter() const
+{
+  return ptr->childFilter();
+}
+
+QString QStyleUpdater::profileName() const
+{
+  return ptr->profileName();
+}
+
+QStyleUpdater::Profile QStyleUpdater::profile() const
+{
+  return ptr->profile();
+}
+
+int QStyleUpdater::repolishBudget() const
+{
+  return ptr->repolishBudget();
+}
+
+bool QStyleUpdater::isRepolishing() const
+{
+  return ptr->isRepolishing();
+}
+
+bool QStyleUpdater::isBatchActive() const
+{
+  return ptr->isBatchActive();
+}
+
+void QStyleUpdater::beginBatch()
+{
+  ptr->beginBatch();
+}
+
+void QStyleUpdater::endBatch()
+{
+  ptr->endBatch();
+}
+
+void QStyleUpdater::postProperty(QWidget *widget, const QByteArray &name, const QVariant &value)
+{
+  ptr->postProperty( widget, name, value );
+}
+
+bool QStyleUpdater::polishProfiling() const
+{
+  return ptr->polishProfiling();
+}
+
+QList<QStyleUpdater::PolishStat> QStyleUpdater::polishStats(int top) const
+{
+  return ptr->polishStats( top );
+}
+
+void QStyleUpdater::clearPolishStats()
+{
+  ptr->clearPolishStats();
+}
+
+bool QStyleUpdater::isRecording() const
+{
+  return ptr->isRecording();
+}
+
+bool QStyleUpdater::startRecording(const QString &fileName)
+{
+  return ptr->startRecording( fileName );
+}
+
+void QStyleUpdater::stopRecording()
+{
+  ptr->stopRecording();
+}
+
+void QStyleUpdater::reloadStyle()
+{
+  ptr->reloadStyle();
+}
+
+void QStyleUpdater::setWidget(QWidget *widget)
+{
+  ptr->setWidget( widget );
+}
+
+void QStyleUpdater::add(const QString &property)
+{
+  ptr->add( property );
+}
+
+void QStyleUpdater::remove(const QString &property)
+{
+  ptr->remove( property );
+}
+
+void QStyleUpdater::setProperties(const QStringList &list)
+{
+  ptr->setProperties( list );
+}
+
+void QStyleUpdater::setRefreshChildWidgets(bool enable)
+{
+  ptr->setRefreshChildWidgets( enable );
+}
+
+void QStyleUpdater::setUpdateWithAllChanges(bool enable)
+{
+  ptr->setUpdateWithAllChanges( enable );
+}
+
+void QStyleUpdater::setChildFilter(const std::function<bool (QWidget *)> &filter)
+{
+  ptr->setChildFilter( filter );
+}
+
+void QStyleUpdater::setChildFilter(const ChildFilter &filter)
+{
+  ptr->setChildFilter( filter );
+}
+
+void QStyleUpdater::setPaintOnlyProperties(const QStringList &list)
+{
+  ptr->setPaintOnlyProperties( list );
+}
+
+void QStyleUpdater::setPolishProfiling(bool enable)
+{
+  ptr->setPolishProfiling( enable );
+}
+
+void QStyleUpdater::setRepolishBudget(int msecs)
+{
+  ptr->setRepolishBudget( msecs );
+}
+
+/*
+ *
+ * QStyleLoader
+ *
+ */
+
+class QStyleLoaderGuardObserver
+{
+protected:
+  QStyleLoaderGuardObserver() { }
+public:
+  virtual ~QStyleLoaderGuardObserver() {}
+
+public:
+  virtual void added(const QString &) = 0;
+  virtual void removed(const QString &) = 0;
+  virtual void changed(const QString &) = 0;
+  virtual void updated(const QStringList &added, const QStringList &removed, const QStringList &changed) = 0;
+};
+
+class QStyleLoaderGuard
+    : public QObject
+{
+protected:
+  QString                   m_path;
+  QStyleLoaderGuardObserver *m_observer;
+protected:
+  QStyleLoaderGuard(const QString &path, QStyleLoaderGuardObserver *observer, QObject *parent)
+    : QObject( parent )
+    , m_path( path )
+    , m_observer( observer )
+  {
+
+  }
+public:
+  virtual ~QStyleLoaderGuard() override
+  {
+
+  }
+
+public:
+  QString path() const
+  {
+    return m_path;
+  }
+};
+
+class QStyleLoaderFileGuard final
+    : public QStyleLoaderGuard
+{
+  QDateTime m_lastEdit;
+public:
+  QStyleLoaderFileGuard(const QString &path, QStyleLoaderGuardObserver *observer, QObject *parent)
+    : QStyleLoaderGuard( path, observer, parent )
+    , m_lastEdit( QFileInfo( path ).lastModified() )
+  {
+    startTimer( 2500 );
+  }
+  ~QStyleLoaderFileGuard() override
+  {
+
+  }
+
+public:
+  bool exists() const
+  {
+    return !m_lastEdit.isNull();
+  }
+
+  // QObject interface
+protected:
+  void timerEvent(QTimerEvent *event) override
+  {
+    QFileInfo f ( m_path );
+    if ( f.exists() ) {
+      if ( m_lastEdit.isNull() ) {
+        m_lastEdit = f.lastModified();
+        m_observer->added( m_path );
+      } else if ( m_lastEdit != f.lastModified() ) {
+        m_lastEdit = f.lastModified();
+        m_observer->changed( m_path );
+      }
+    } else if ( !m_lastEdit.isNull() ) {
+      m_lastEdit = QDateTime();
+      m_observer->removed( m_path );
+    }
+
+    QStyleLoaderGuard::timerEvent( event );
+  }
+};
+
+class QStyleLoaderDirectoryGuard final
+    : public QStyleLoaderGuard
+{
+  struct Entry
+  {
+    qint64  size;
+    qint64  modified;
+    qint64  metadataChanged;  ///< A file renamed over the original keeps its times, not this one
+
+    bool operator!=(const Entry &e) const
+    {
+      return size != e.size || modified != e.modified || metadataChanged != e.metadataChanged;
+    }
+  };
+
+  QStyleLoaderFileFilter  m_filter;
+  QHash<QString, Entry>   m_entries;
+public:
+  QStyleLoaderDirectoryGuard(const QString &path, const QStyleLoaderFileFilter &filter, QStyleLoaderGuardObserver *observer, QObject *parent)
+    : QStyleLoaderGuard( path, observer, parent )
+    , m_filter( filter )
+    , m_entries( scan() )
+  {
+    startTimer( 2500 );
+  }
+  ~QStyleLoaderDirectoryGuard() override
+  {
+
+  }
+
+public:
+  QStyleLoaderFileFilter filter() const
+  {
+    return m_filter;
+  }
+
+  void setFilter(const QStyleLoaderFileFilter &filter)
+  {
+    m_filter = filter;
+    updateEntries();
+  }
+
+private:
+  ///
+  /// Walks the whole tree once and returns a flat snapshot of the files.
+  /// Directories are identified by their canonical path, so symbolic
+  /// links that point back into the tree are visited only once.
+  ///
+  QHash<QString, Entry> scan() const
+  {
+    QHash<QString, Entry> result;
+    QSet<QString> visited;
+    QStringList dirs { QDir::fromNativeSeparators( m_path ) };
+
+    while ( !dirs.isEmpty() ) {
+      QDir directory( dirs.takeLast() );
+      auto canonical = directory.canonicalPath();
+      if ( canonical.isEmpty() || visited.contains( canonical ) )
+        continue;
+      visited.insert( canonical );
+
+      for ( auto &info: directory.entryInfoList( QDir::Files | QDir::Dirs | QDir::NoDotAndDotDot ) ) {
+        if ( info.isDir() ) {
+          dirs << info.absoluteFilePath();
+        } else if ( m_filter.match( info.fileName() ) ) {
+          result.insert( info.absoluteFilePath(),
+                         Entry { info.size(),
+                                 info.lastModified().toMSecsSinceEpoch(),
+                                 info.metadataChangeTime().toMSecsSinceEpoch() } );
+        }
+      }
+    }
+
+    return result;
+  }
+
+  void updateEntries()
+  {
+    QStringList added, removed, changed;
+    auto entries = scan();
+
+    for ( auto it = entries.cbegin(); it != entries.cend(); ++it ) {
+      auto old = m_entries.constFind( it.key() );
+      if ( old == m_entries.cend() )
+        added << it.key();
+      else if ( *old != it.value() )
+        changed << it.key();
+    }
+
+    for ( auto it = m_entries.cbegin(); it != m_entries.cend(); ++it )
+      if ( !entries.contains( it.key() ) )
+        removed << it.key();
+
+    m_entries.swap( entries );
+    if ( !added.isEmpty() || !removed.isEmpty() || !changed.isEmpty() )
+      m_observer->updated( added, removed, changed );
+  }
+
+  // QObject interface
+protected:
+  void timerEvent(QTimerEvent *event) override
+  {
+    updateEntries();
+    QStyleLoaderGuard::timerEvent( event );
+  }
+};
+
+static QString loadStyleFile(const QString &path)
+{
+  QString result;
+  QFile f ( QDir::fromNativeSeparators( path ) );
+  if ( f.open( QIODevice::ReadOnly ) ) {
+    result = QString::fromUtf8( f.readAll() );
+    f.close();
+  } else {
+    qDebug() << f.errorString();
+  }
+
+  return result;
+}
+
+static QString loadStyleDirectory(const QString &path, const QStyleLoaderFileFilter &filter)
+{
+  QStringList result;
+  for ( auto &file: filter.files( path ) ) {
+    auto data = loadStyleFile( file );
+    if ( !data.isEmpty() )
+      result << data;
+  }
+
+  return result.join( '\n' );
+}
+
+///
+/// Moves simple color rules of bare type selectors ("*", "QLabel") into
+/// application palettes and returns the rest of the rules as a style sheet.
+/// A rule is baked only when the palette gives the same result as the
+/// cascade, otherwise it stays in the style sheet. Unknown classes are
+/// assumed to be related, so their rules are baked for one class at most.
+///
+class QStyleLoaderPaletteBaker
+{
+public:
+  static QString bake(const QList<QStyleSheetRule> &rules, const QPalette &base)
+  {
+    QVector<bool> baked( rules.size() );
+    for ( int i = 0; i < rules.size(); ++i )
+      baked[ i ] = isBakeable( rules.at( i ) );
+
+    auto classes = knownClasses();
+    auto changed = true;
+    while ( changed ) {
+      changed = false;
+
+      // Bare rules left in the sheet override the palette,
+      // even when the cascade says the baked rule wins
+      QSet<QString> blocked;
+      for ( int i = 0; i < rules.size(); ++i )
+        if ( !baked.at( i ) && hasBareSelector( rules.at( i ) ) )
+          for ( auto &d: rules.at( i ).declarations )
+            blocked.insert( propertyKey( d.first ) );
+
+      // A widget without a palette of its own class gets the palette of any
+      // inherited class, in hash order, and palettes are never merged. So the
+      // baked classes must not inherit each other: the later one stays in the sheet.
+      QStringList seen;
+      for ( int i = 0; i < rules.size(); ++i ) {
+        if ( !baked.at( i ) )
+          continue;
+
+        auto &rule = rules.at( i );
+        for ( auto &d: rule.declarations )
+          if ( blocked.contains( propertyKey( d.first ) ) )
+            baked[ i ] = false;
+
+        for ( auto &selector: rule.selectors ) {
+          if ( selector == "*" )
+            continue;
+          for ( auto &earlier: seen )
+            if ( earlier != selector && ( mayInherit( classes, earlier, selector ) || mayInherit( classes, selector, earlier ) ) )
+              baked[ i ] = false;
+        }
+
+        if ( !baked.at( i ) ) {
+          changed = true;
+          break;
+        }
+
+        for ( auto &selector: rule.selectors )
+          if ( selector != "*" && !seen.contains( selector ) )
+            seen << selector;
+      }
+    }
+
+    // Universal rules always lose to type rules, so they form the base palette
+    QPalette global = base;
+    for ( int i = 0; i < rules.size(); ++i )
+      if ( baked.at( i ) && rules.at( i ).selectors.contains( "*" ) )
+        applyRule( rules.at( i ), global );
+
+    QStringList order;
+    QHash<QString, QPalette> palettes;
+    QStringList remaining;
+    for ( int i = 0; i < rules.size(); ++i ) {
+      auto &rule = rules.at( i );
+      if ( !baked.at( i ) ) {
+        remaining << rule.text();
+        continue;
+      }
+
+      for ( auto &selector: rule.selectors ) {
+        if ( selector == "*" )
+          continue;
+        if ( !palettes.contains( selector ) ) {
+          palettes.insert( selector, global );
+          order << selector;
+        }
+        applyRule( rule, palettes[ selector ] );
+      }
+    }
+
+    // The palette without a class name also drops the class palettes
+    QApplication::setPalette( global );
+    for ( auto &name: order )
+      QApplication::setPalette( palettes.value( name ), name.toLatin1().constData() );
+
+    return remaining.join( '\n' );
+  }
+
+private:
+  static QList<QPalette::ColorRole> roles(const QString &property)
+  {
+    // Backgrounds are not baked: the style sheet fills the widget, a palette
+    // does not (a QLabel never fills Window, a native button draws a bevel)
+    if ( property == "color" )
+      return { QPalette::WindowText, QPalette::Text, QPalette::ButtonText };
+    if ( property == "selection-color" )
+      return { QPalette::HighlightedText };
+    if ( property == "selection-background-color" )
+      return { QPalette::Highlight };
+    if ( property == "alternate-background-color" )
+      return { QPalette::AlternateBase };
+    return {};
+  }
+
+  static QString propertyKey(const QString &property)
+  {
+    return property == "background" ? QString( "background-color" ) : property;
+  }
+
+  static bool parseColor(const QString &value, QColor &color)
+  {
+    static const QRegularExpression rgb( "^rgba?\\(\\s*(\\d+)\\s*,\\s*(\\d+)\\s*,\\s*(\\d+)\\s*(?:,\\s*(\\d+(?:\\.\\d+)?)\\s*(%?)\\s*)?\\)$" );
+
+    auto match = rgb.match( value );
+    if ( match.hasMatch() ) {
+      color = QColor( qBound( 0, match.captured( 1 ).toInt(), 255 ),
+                      qBound( 0, match.captured( 2 ).toInt(), 255 ),
+                      qBound( 0, match.captured( 3 ).toInt(), 255 ) );
+      if ( !match.captured( 4 ).isEmpty() ) {
+        auto alpha = match.captured( 4 ).toDouble();
+        color.setAlpha( match.captured( 5 ).isEmpty()
+                        ? qBound( 0, qRound( alpha ), 255 )
+                        : qBound( 0, qRound( alpha * 2.55 ), 255 ) );
+      }
+      return true;
+    }
+
+    if ( value.contains( ' ' ) || value.contains( '(' ) )
+      return false;
+
+    color = QColor( value );
+    return color.isValid();
+  }
+
+  static bool isBareSelector(const QString &selector)
+  {
+    static const QRegularExpression bare( "^(\\*|[A-Za-z_][\\w-]*)$" );
+    return bare.match( selector ).hasMatch();
+  }
+
+  static bool hasBareSelector(const QStyleSheetRule &rule)
+  {
+    for ( auto &selector: rule.selectors )
+      if ( isBareSelector( selector ) )
+        return true;
+    return false;
+  }
+
+  static bool isBakeable(const QStyleSheetRule &rule)
+  {
+    if ( rule.declarations.isEmpty() )
+      return false;
+
+    for ( auto &selector: rule.selectors )
+      if ( !isBareSelector( selector ) )
+        return false;
+
+    QColor color;
+    for ( auto &d: rule.declarations )
+      if ( roles( d.first ).isEmpty() || !parseColor( d.second, color ) )
+        return false;
+
+    return true;
+  }
+
+  static void applyRule(const QStyleSheetRule &rule, QPalette &palette)
+  {
+    QColor color;
+    for ( auto &d: rule.declarations )
+      if ( parseColor( d.second, color ) )
+        for ( auto role: roles( d.first ) )
+          palette.setColor( role, color );
+  }
+
+  static QHash<QString, const QMetaObject*> knownClasses()
+  {
+    QHash<QString, const QMetaObject*> result;
+    for ( auto widget: QApplication::allWidgets() )
+      for ( auto meta = widget->metaObject(); meta; meta = meta->superClass() )
+        result.insert( meta->className(), meta );
+    return result;
+  }
+
+  static bool mayInherit(const QHash<QString, const QMetaObject*> &classes, const QString &name, const QString &base)
+  {
+    if ( base == "QWidget" )
+      return true;
+
+    auto meta = classes.value( name );
+    if ( !meta )
+      return true;
+
+    for ( ; meta; meta = meta->superClass() )
+      if ( base == meta->className() )
+        return true;
+    return false;
+  }
+};
+
+///
+/// Splits a style sheet by the widget classes its rules target. A rule is
+/// bound to classes only when every selector names a type and has no
+/// ancestors, all other rules are global. The sheet keeps the global rules
+/// and the rules of the active classes in their original order.
+///
+/// Every activation re-applies the sheet, which repolishes all widgets of
+/// the application. After MaxActivations of them all classes are activated,
+/// so a sheet costs at most that many extra repolishes.
+///
+class QStyleLoaderPartition
+{
+  static const int MaxActivations = 16;
+
+  struct Rule
+  {
+    QString     text;
+    QStringList types;      ///< Empty for global rules
+  };
+
+  QList<Rule>               m_rules;
+  QSet<QString>             m_types;
+  QSet<QString>             m_active;
+  QSet<const QMetaObject*>  m_seen;     ///< Classes already checked
+  int                       m_activations;
+  bool                      m_full;     ///< All rules are applied, kept across sheets
+public:
+  QStyleLoaderPartition()
+    : m_activations( 0 )
+    , m_full( false )
+  {
+
+  }
+
+  void setStyleSheet(const QString &styleSheet)
+  {
+    m_rules.clear();
+    m_types.clear();
+    for ( auto &rule: QStyleSheetRule::parse( styleSheet ) ) {
+      Rule r { rule.text(), QStringList() };
+      for ( auto &text: rule.selectors ) {
+        auto selector = QStyleSheetSelector::parse( text );
+        if ( selector.type.isEmpty() || selector.hasAncestors ) {
+          r.types.clear();
+          break;
+        }
+        // Namespaced classes are written as "ns--Class" in style sheets
+        auto type = selector.type.replace( "--", "::" );
+        if ( !r.types.contains( type ) )
+          r.types << type;
+      }
+      for ( auto &type: r.types )
+        m_types.insert( type );
+      m_rules << r;
+    }
+
+    // Classes created under the previous sheet stay active, applying a
+    // sheet costs no extra repolish, so the activations are not counted
+    m_active.clear();
+    if ( m_full ) {
+      m_active = m_types;
+      return;
+    }
+    for ( auto meta: m_seen )
+      activateTypes( meta );
+  }
+
+  ///
+  /// Marks the classes of the widgets and of their base classes as used,
+  /// returns true when a rule was activated.
+  ///
+  bool activate(const QList<QWidget*> &widgets)
+  {
+    if ( m_full )
+      return false;
+
+    auto activated = false;
+    for ( auto widget: widgets ) {
+      auto meta = widget->metaObject();
+      if ( !m_seen.contains( meta ) ) {
+        m_seen.insert( meta );
+        activated = activateTypes( meta ) || activated;
+      }
+    }
+
+    if ( activated && ++m_activations >= MaxActivations ) {
+      m_full = true;
+      m_active = m_types;
+    }
+    return activated;
+  }
+
+  ///
+  /// Forgets the used classes, the existing widgets are seen again.
+  ///
+  void reset()
+  {
+    m_seen.clear();
+    m_active.clear();
+    m_activations = 0;
+    m_full = false;
+    for ( auto widget: QApplication::allWidgets() )
+      m_seen.insert( widget->metaObject() );
+  }
+
+  QString styleSheet() const
+  {
+    QStringList rules;
+    for ( auto &rule: m_rules ) {
+      auto active = rule.types.isEmpty();
+      for ( int i = 0; !active && i < rule.types.size(); ++i )
+        active = m_active.contains( rule.types.at( i ) );
+      if ( active )
+        rules << rule.text;
+    }
+    return rules.join( '\n' );
+  }
+
+private:
+  bool activateTypes(const QMetaObject *meta)
+  {
+    auto activated = false;
+    for ( ; meta; meta = meta->superClass() ) {
+      auto name = QString::fromLatin1( meta->className() );
+      if ( m_types.contains( name ) && !m_active.contains( name ) ) {
+        m_active.insert( name );
+        activated = true;
+      }
+    }
+    return activated;
+  }
+};
+
+///
+/// Assembles the style sheet of a theme in a thread of the global pool.
+/// The loader polls the shared state, so the job never touches the loader.
+///
+class QStyleLoaderThemeJob final
+    : public QRunnable
+{
+public:
+  struct State
+  {
+    QList<QPair<QStyleLoader::Item, QByteArray>>  items;
+    QStyleLoaderFileFilter                        filter;
+    QString                                       styleSheet;
+    std::atomic<bool>                             done { false };
+  };
+private:
+  std::shared_ptr<State> m_state;
+public:
+  QStyleLoaderThemeJob(const std::shared_ptr<State> &state)
+    : m_state( state )
+  {
+
+  }
+
+public:
+  void run() override
+  {
+    QStringList result;
+    for ( auto &item: m_state->items ) {
+      QString data;
+      auto &path = item.first.path;
+      switch ( item.first.type ) {
+        case QStyleLoader::Item::Type::Buffer:
+          data = QString::fromUtf8( item.second );
+          break;
+        case QStyleLoader::Item::Type::File:
+          data = loadStyleFile( path );
+          break;
+        default:
+          data = QFileInfo( path ).isDir()
+              ? loadStyleDirectory( path, m_state->filter )
+              : loadStyleFile( path );
+      }
+      if ( !data.isEmpty() )
+        result << data;
+    }
+
+    m_state->styleSheet = result.join( '\n' );
+    m_state->done.store( true, std::memory_order_release );
+  }
+};
+
+///
+/// Push messages are QByteArray frames of a QDataStream (a 32-bit big-endian
+/// length followed by the payload). The payload holds the kind, the item name
+/// and the body of the style.
+///
+enum QStyleLoaderPushKind : quint8
+{
+  PushItem  = 1,
+  PushSheet = 2,
+  PushReset = 3
+};
+
+static QByteArray encodePush(QStyleLoaderPushKind kind, const QString &name, const QByteArray &data)
+{
+  QByteArray payload;
+  {
+    QDataStream stream ( &payload, QIODevice::WriteOnly );
+    stream.setVersion( QDataStream::Qt_5_6 );
+    stream << quint8( kind ) << name << data;
+  }
+
+  QByteArray frame;
+  QDataStream stream ( &frame, QIODevice::WriteOnly );
+  stream.setVersion( QDataStream::Qt_5_6 );
+  stream << payload;
+  return frame;
+}
+
+#ifdef QT_NETWORK_LIB
+class QStyleLoaderPushServer final
+    : public QObject
+{
+  typedef std::function<void(quint8, const QString &, const QByteArray &)> Handler;
+
+  static const int MaxFrameSize = 64 * 1024 * 1024;
+
+  QHash<QLocalSocket*, QByteArray>  m_buffers;
+  Handler                           m_handler;
+  QLocalServer                      m_server;   // Destroyed first, with its sockets
+public:
+  QStyleLoaderPushServer(const Handler &handler, QObject *parent = nullptr)
+    : QObject( parent )
+    , m_handler( handler )
+  {
+    connect( &m_server, &QLocalServer::newConnection, this, [this]() {
+      while ( auto socket = m_server.nextPendingConnection() ) {
+        connect( socket, &QLocalSocket::readyRead, this, [this, socket]() { read( socket ); } );
+        connect( socket, &QLocalSocket::disconnected, socket, &QObject::deleteLater );
+        connect( socket, &QObject::destroyed, this, [this, socket]() { m_buffers.remove( socket ); } );
+      }
+    });
+  }
+
+  bool listen(const QString &name)
+  {
+    // Only processes of the same user may push style sheets
+    m_server.setSocketOptions( QLocalServer::UserAccessOption );
+    if ( m_server.listen( name ) )
+      return true;
+    if ( m_server.serverError() != QAbstractSocket::AddressInUseError )
+      return false;
+
+    // The channel of a running instance is never taken over
+    QLocalSocket probe;
+    probe.connectToServer( name );
+    if ( probe.waitForConnected( 100 ) ) {
+      probe.abort();
+      return false;
+    }
+
+    // A socket file left behind by a crashed process
+    QLocalServer::removeServer( name );
+    return m_server.listen( name );
+  }
+
+  QString serverName() const
+  {
+    return m_server.serverName();
+  }
+
+private:
+  void read(QLocalSocket *socket)
+  {
+    auto &buffer = m_buffers[ socket ];
+    buffer += socket->readAll();
+
+    while ( buffer.size() >= 4 ) {
+      auto size = qFromBigEndian<quint32>( reinterpret_cast<const uchar*>( buffer.constData() ) );
+      if ( size > quint32( MaxFrameSize ) ) {
+        socket->abort();
+        return;
+      }
+      if ( quint32( buffer.size() ) < 4 + size )
+        break;
+
+      QByteArray payload;
+      {
+        QDataStream frame ( buffer );
+        frame.setVersion( QDataStream::Qt_5_6 );
+        frame >> payload;
+      }
+      buffer.remove( 0, int( 4 + size ) );
+
+      quint8 kind = 0;
+      QString name;
+      QByteArray data;
+      QDataStream stream ( payload );
+      stream.setVersion( QDataStream::Qt_5_6 );
+      stream >> kind >> name >> data;
+      if ( stream.status() == QDataStream::Ok )
+        m_handler( kind, name, data );
+    }
+  }
+};
+#endif
+
+static bool sendPush(const QString &serverName, const QByteArray &frame, int timeout)
+{
+#ifdef QT_NETWORK_LIB
+  QLocalSocket socket;
+  socket.connectToServer( serverName );
+  if ( !socket.waitForConnected( timeout ) )
+    return false;
+
+  socket.write( frame );
+  while ( socket.bytesToWrite() > 0 )
+    if ( !socket.waitForBytesWritten( timeout ) )
+      return false;
+
+  socket.disconnectFromServer();
+  return true;
+#else
+  Q_UNUSED( serverName );
+  Q_UNUSED( frame );
+  Q_UNUSED( timeout );
+  return false;
+#endif
+}
+
+///
+/// Assembled sheet shared by the processes of the host. The segment starts with
+/// a header, followed by the manifest of the sources and by the sheet (UTF-8).
+/// The owner renews the heartbeat, a stale heartbeat lets another process take over.
+///
+class QStyleLoaderSharedCache final
+{
+  struct Header
+  {
+    quint32 magic;
+    quint32 layout;
+    quint64 version;
+    qint64  owner;
+    qint64  heartbeat;
+    quint32 manifestSize;
+    quint32 sheetSize;
+  };
+
+  static const quint32 Magic  = 0x51534C43; // "QSLC"
+  static const quint32 Layout = 1;
+
+  QSharedMemory m_memory;
+  bool          m_owner;
+  bool          m_ready;
+  QElapsedTimer m_attached;
+  QByteArray    m_publishedManifest;
+  QByteArray    m_publishedSheet;
+public:
+  explicit QStyleLoaderSharedCache(const QString &key)
+    : m_memory( key )
+    , m_owner( false )
+    , m_ready( false )
+  {
+
+  }
+  ~QStyleLoaderSharedCache()
+  {
+    release();
+  }
+
+public:
+  bool isOwner() const
+  {
+    return m_owner;
+  }
+
+  bool open(int capacity)
+  {
+    if ( m_memory.create( int( sizeof( Header ) ) + qMax( 0, capacity ) ) ) {
+      m_memory.lock();
+      *header() = Header { Magic, Layout, 0, QCoreApplication::applicationPid(), now(), 0, 0 };
+      m_memory.unlock();
+      m_owner = true;
+      m_ready = true;
+      return true;
+    }
+
+    if ( m_memory.error() != QSharedMemory::AlreadyExists || !m_memory.attach() )
+      return false;
+    if ( m_memory.size() < int( sizeof( Header ) ) ) {
+      m_memory.detach();
+      return false;
+    }
+
+    m_memory.lock();
+    auto magic = header()->magic;
+    auto layout = header()->layout;
+    m_memory.unlock();
+
+    // The creator may not have written the header yet, isReady checks it again
+    m_attached.start();
+    if ( magic == 0 )
+      return true;
+
+    m_ready = magic == Magic && layout == Layout;
+    if ( !m_ready )
+      m_memory.detach();
+    return m_ready;
+  }
+
+  ///
+  /// The header is written. When its creator died before writing it,
+  /// this process initializes the segment after the timeout and owns it.
+  ///
+  bool isReady(qint64 timeout)
+  {
+    if ( m_ready )
+      return true;
+
+    m_memory.lock();
+    auto h = header();
+    if ( h->magic == Magic && h->layout == Layout ) {
+      m_ready = true;
+    } else if ( h->magic == 0 && m_attached.elapsed() > timeout ) {
+      *h = Header { Magic, Layout, 0, QCoreApplication::applicationPid(), now(), 0, 0 };
+      m_ready = true;
+      m_owner = true;
+    }
+    m_memory.unlock();
+    return m_ready;
+  }
+
+  ///
+  /// A sheet that does not fit is published empty, so the other
+  /// processes see a different manifest and load their own files.
+  ///
+  bool publish(const QByteArray &manifest, const QByteArray &sheet)
+  {
+    if ( !m_owner )
+      return false;
+
+    // Readers copy the segment on every new version, identical sheets are not published
+    auto fits = manifest.size() + sheet.size() <= m_memory.size() - int( sizeof( Header ) );
+    if ( manifest == m_publishedManifest && sheet == m_publishedSheet )
+      return fits;
+    m_publishedManifest = manifest;
+    m_publishedSheet = sheet;
+
+    m_memory.lock();
+    auto h = header();
+    h->manifestSize = fits ? quint32( manifest.size() ) : 0;
+    h->sheetSize = fits ? quint32( sheet.size() ) : 0;
+    if ( fits ) {
+      memcpy( payload(), manifest.constData(), size_t( manifest.size() ) );
+      memcpy( payload() + manifest.size(), sheet.constData(), size_t( sheet.size() ) );
+    }
+    ++h->version;
+    h->heartbeat = now();
+    m_memory.unlock();
+    return fits;
+  }
+
+  bool read(quint64 &version, QByteArray &manifest, QByteArray &sheet)
+  {
+    if ( !m_ready )
+      return false;
+
+    m_memory.lock();
+    auto h = header();
+    version = h->version;
+    manifest = QByteArray( payload(), int( h->manifestSize ) );
+    sheet = QByteArray( payload() + h->manifestSize, int( h->sheetSize ) );
+    m_memory.unlock();
+    return true;
+  }
+
+  quint64 version()
+  {
+    m_memory.lock();
+    auto result = header()->version;
+    m_memory.unlock();
+    return result;
+  }
+
+  ///
+  /// Renews the heartbeat, returns false when another process took over
+  ///
+  bool heartbeat()
+  {
+    if ( !m_owner )
+      return false;
+
+    m_memory.lock();
+    if ( header()->owner == QCoreApplication::applicationPid() )
+      header()->heartbeat = now();
+    else
+      m_owner = false;
+    m_memory.unlock();
+    return m_owner;
+  }
+
+  bool takeOver(qint64 timeout)
+  {
+    m_memory.lock();
+    auto h = header();
+    if ( h->owner == 0 || now() - h->heartbeat > timeout ) {
+      h->owner = QCoreApplication::applicationPid();
+      h->heartbeat = now();
+      m_owner = true;
+      m_publishedManifest.clear();
+      m_publishedSheet.clear();
+    }
+    m_memory.unlock();
+    return m_owner;
+  }
+
+  void release()
+  {
+    if ( !m_owner )
+      return;
+
+    m_memory.lock();
+    if ( header()->owner == QCoreApplication::applicationPid() ) {
+      header()->owner = 0;
+      header()->heartbeat = 0;
+    }
+    m_memory.unlock();
+    m_owner = false;
+  }
+
+private:
+  Header *header()
+  {
+    return static_cast<Header*>( m_memory.data() );
+  }
+  char *payload()
+  {
+    return static_cast<char*>( m_memory.data() ) + sizeof( Header );
+  }
+  static qint64 now()
+  {
+    return QDateTime::currentMSecsSinceEpoch();
+  }
+};
+
+class QStyleLoader::_QStyleLoader
+    : public QObject
+    , public QStyleLoaderGuardObserver
+{
+  struct Theme
+  {
+    QList<Item>                                   items;
+    QString                                       styleSheet;
+    bool                                          ready;
+    std::shared_ptr<QStyleLoaderThemeJob::State>  job;
+
+    Theme() : ready( false ) { }
+  };
+
+  QStyleLoader                      *m_root;
+  bool                              m_autoReload;
+  bool                              m_hasReload;
+  int                               m_batchDepth;
+  QDateTime                         m_lastReloaded;
+  QList<Item>                       m_items;
+  QStyleLoaderFileFilter            m_filter;
+  QMap<QString, QByteArray>         m_buffers;
+  QMap<QString, QString>            m_resources;
+  QMap<QString, QString>            m_cache;
+  QList<Item>                       m_pending;
+  QStringList                       m_paintOnlyProperties;
+  int                               m_reloadTimer;
+  int                               m_pendingTimer;
+  QList<QStyleUpdater*>             m_updaters;
+  QMap<QString, QStyleLoaderGuard*> m_guards;
+  QMap<QString, Theme>              m_themes;
+  QString                           m_theme;
+  bool                              m_backgroundThemes;
+  QString                           m_styleSheet;
+  bool                              m_paletteBaking;
+  bool                              m_paletteBaked;
+  QPalette                          m_basePalette;
+  bool                              m_lazyPartitioning;
+  QStyleLoaderPartition             m_partition;
+  bool                              m_partitionApplying;
+  bool                              m_partitionPending;
+  bool                              m_profiling;
+  QList<QPair<QString, QStyleSheetSelector>>  m_selectors;
+  QHash<QString, QStyleUpdater::PolishStat>   m_polishStats;
+  QHash<QString, RuleStat>                    m_ruleStats;
+  QMap<QString, std::shared_ptr<QStyleUpdaterConfigHolder>> m_profiles;
+  QMap<QString, QString>            m_overrides;
+  QString                           m_sheetOverride;
+  bool                              m_hasSheetOverride;
+  int                               m_pushTimer;
+  std::unique_ptr<QStyleLoaderSharedCache>  m_shared;
+  bool                              m_sharedReader;
+  quint64                           m_sharedVersion;
+  int                               m_sharedTimer;
+#ifdef QT_NETWORK_LIB
+  QStyleLoaderPushServer            *m_server;
+#endif
+  mutable std::recursive_mutex  m_locker;
+public:
+  _QStyleLoader(QStyleLoader *root)
+    : QObject( root )
+    , m_root( root )
+    , m_autoReload( true )
+    , m_hasReload( false )
+    , m_batchDepth( 0 )
+    , m_pendingTimer( 0 )
+    , m_backgroundThemes( false )
+    , m_paletteBaking( false )
+    , m_paletteBaked( false )
+    , m_lazyPartitioning( false )
+    , m_partitionApplying( false )
+    , m_partitionPending( false )
+    , m_profiling( false )
+    , m_hasSheetOverride( false )
+    , m_pushTimer( 0 )
+    , m_sharedReader( false )
+    , m_sharedVersion( 0 )
+    , m_sharedTimer( 0 )
+#ifdef QT_NETWORK_LIB
+    , m_server( nullptr )
+#endif
+  {
+    m_reloadTimer = startTimer( 2000 );
+  }
+  ~_QStyleLoader() override
+  {
+    if ( m_lazyPartitioning && qApp )
+      qApp->removeEventFilter( this );
+  }
+
+public:
+  int count() const
+  {
+    return m_items.count();
+  }
+  Item at(int index) const
+  {
+    std::lock_guard<std::recursive_mutex> locker( m_locker );
+    return index >= 0 && index < m_items.count()
+        ? m_items.at( index )
+        : Item();
+  }
+  QList<Item> items() const
+  {
+    return m_items;
+  }
+  QStringList fileFilters() const
+  {
+    std::lock_guard<std::recursive_mutex> locker( m_locker );
+    return m_filter.include();
+  }
+  QStringList excludeFilters() const
+  {
+    std::lock_guard<std::recursive_mutex> locker( m_locker );
+    return m_filter.exclude();
+  }
+
+  bool contains(const QString &path) const
+  {
+    std::lock_guard<std::recursive_mutex> locker( m_locker );
+    for ( auto &item: m_items )
+      if ( item.path == path )
+        return true;
+    return false;
+  }
+  bool containsFile(const QString &path) const
+  {
+    std::lock_guard<std::recursive_mutex> locker( m_locker );
+    for ( auto &item: m_items )
+      if ( item.type == Item::Type::File && item.path == path )
+        return true;
+    return false;
+  }
+  bool containsDirectory(const QString &path) const
+  {
+    std::lock_guard<std::recursive_mutex> locker( m_locker );
+    for ( auto &item: m_items )
+      if ( item.type == Item::Type::Directory && item.path == path )
+        return true;
+    return false;
+  }
+  bool containsBuffer(const QString &name) const
+  {
+    std::lock_guard<std::recursive_mutex> locker( m_locker );
+    for ( auto &item: m_items )
+      if ( item.type == Item::Type::Buffer && item.path == name )
+        return true;
+    return false;
+  }
+  bool containsResource(const QString &path) const
+  {
+    std::lock_guard<std::recursive_mutex> locker( m_locker );
+    for ( auto &item: m_items )
+      if ( item.type == Item::Type::Resource && item.path == path )
+        return true;
+    return false;
+  }
+  QByteArray buffer(const QString &name) const
+  {
+    std::lock_guard<std::recursive_mutex> locker( m_locker );
+    return m_buffers.value( name );
+  }
+
+  QList<QStyleUpdater*> updaters() const
+  {
+    return m_updaters;
+  }
+  bool containsUpdater(QWidget *widget) const
+  {
+    std::lock_guard<std::recursive_mutex> locker( m_locker );
+    for ( auto updater: m_updaters )
+      if ( updater->widget() == widget )
+        return true;
+    return false;
+  }
+  QStyleUpdater *updater(QWidget *widget) const
+  {
+    std::lock_guard<std::recursive_mutex> locker( m_locker );
+    for ( auto updater: m_updaters )
+      if ( updater->widget() == widget )
+        return updater;
+    return nullptr;
+  }
+
+  bool autoReloadStyle() const
+  {
+    return m_autoReload;
+  }
+  QStringList paintOnlyProperties() const
+  {
+    std::lock_guard<std::recursive_mutex> locker( m_locker );
+    return m_paintOnlyProperties;
+  }
+
+  QStringList themes() const
+  {
+    std::lock_guard<std::recursive_mutex> locker( m_locker );
+    return m_themes.keys();
+  }
+  QString theme() const
+  {
+    return m_theme;
+  }
+  QList<Item> themeItems(const QString &theme) const
+  {
+    std::lock_guard<std::recursive_mutex> locker( m_locker );
+    return m_themes.value( theme ).items;
+  }
+  bool backgroundThemeLoading() const
+  {
+    return m_backgroundThemes;
+  }
+
+  QString styleSheet() const
+  {
+    std::lock_guard<std::recursive_mutex> locker( m_locker );
+    return m_styleSheet;
+  }
+  bool paletteBaking() const
+  {
+    return m_paletteBaking;
+  }
+  bool lazyPartitioning() const
+  {
+    return m_lazyPartitioning;
+  }
+
+  bool isListening() const
+  {
+#ifdef QT_NETWORK_LIB
+    return !!m_server;
+#else
+    return false;
+#endif
+  }
+  QString serverName() const
+  {
+#ifdef QT_NETWORK_LIB
+    if ( m_server )
+      return m_server->serverName();
+#endif
+    return QString();
+  }
+
+  bool isSharing() const
+  {
+    std::lock_guard<std::recursive_mutex> locker( m_locker );
+    return !!m_shared;
+  }
+  bool isSharedOwner() const
+  {
+    std::lock_guard<std::recursive_mutex> locker( m_locker );
+    return m_shared && m_shared->isOwner();
+  }
+
+  bool polishProfiling() const
+  {
+    return m_profiling;
+  }
+  QList<QStyleUpdater::PolishStat> polishStats(int top) const
+  {
+    std::lock_guard<std::recursive_mutex> locker( m_locker );
+    return topStats( m_polishStats, top );
+  }
+  QStringList profiles() const
+  {
+    std::lock_guard<std::recursive_mutex> locker( m_locker );
+    return m_profiles.keys();
+  }
+  QStyleUpdater::Profile profile(const QString &name) const
+  {
+    std::lock_guard<std::recursive_mutex> locker( m_locker );
+    auto holder = m_profiles.value( name );
+    return holder ? holder->config->profile() : QStyleUpdater::Profile();
+  }
+  QList<RuleStat> ruleStats(int top) const
+  {
+    std::lock_guard<std::recursive_mutex> locker( m_locker );
+    return topStats( m_ruleStats, top );
+  }
+  void clearPolishStats()
+  {
+    std::lock_guard<std::recursive_mutex> locker( m_locker );
+    m_polishStats.clear();
+    m_ruleStats.clear();
+    for ( auto updater: m_updaters )
+      updater->clearPolishStats();
+  }
+
+  bool isBatchActive() const
+  {
+    return m_batchDepth > 0;
+  }
+  void beginBatch()
+  {
+    std::lock_guard<std::recursive_mutex> locker( m_locker );
+    if ( m_batchDepth++ == 0 )
+      for ( auto updater: m_updaters )
+        updater->beginBatch();
+  }
+  void endBatch()
+  {
+    std::lock_guard<std::recursive_mutex> locker( m_locker );
+    if ( m_batchDepth == 0 || --m_batchDepth > 0 )
+      return;
+
+    if ( m_hasReload )
+      reloadAllStyle();
+
+    for ( auto updater: m_updaters )
+      updater->endBatch();
+  }
+public slots:
+  void add(Item::Type type, const QString &path, Item::Priority priority)
+  {
+    std::lock_guard<std::recursive_mutex> locker( m_locker );
+    switch ( type ) {
+      case Item::Type::File:      addFile( path, priority ); break;
+      case Item::Type::Directory: addDirectory( path, priority ); break;
+      case Item::Type::Buffer:    addBuffer( path, QByteArray(), priority ); break;
+      case Item::Type::Resource:  addResource( path, priority ); break;
+    }
+  }
+  void addFile(const QString &path, Item::Priority priority)
+  {
+    std::lock_guard<std::recursive_mutex> locker( m_locker );
+    if ( !containsFile( path ) ) {
+      m_items << Item { Item::Type::File, path, priority };
+      watch( m_items.last() );
+      itemAdded( m_items.last() );
+    }
+  }
+  void addDirectory(const QString &path, Item::Priority priority)
+  {
+    std::lock_guard<std::recursive_mutex> locker( m_locker );
+    if ( !containsDirectory( path ) ) {
+      m_items << Item { Item::Type::Directory, path, priority };
+      watch( m_items.last() );
+      itemAdded( m_items.last() );
+    }
+  }
+  void addResource(const QString &path, Item::Priority priority)
+  {
+    std::lock_guard<std::recursive_mutex> locker( m_locker );
+    if ( !containsResource( path ) ) {
+      // Resources are compiled into the binary, so they are
+      // read once by loadItem and never get a guard.
+      m_items << Item { Item::Type::Resource, path, priority };
+      itemAdded( m_items.last() );
+    }
+  }
+  void addBuffer(const QString &name, const QByteArray &data, Item::Priority priority)
+  {
+    std::lock_guard<std::recursive_mutex> locker( m_locker );
+    if ( !containsBuffer( name ) ) {
+      m_items << Item { Item::Type::Buffer, name, priority };
+      m_buffers[ name ] = data;
+      itemAdded( m_items.last() );
+    }
+  }
+  void setBuffer(const QString &name, const QByteArray &data, Item::Priority priority)
+  {
+    std::lock_guard<std::recursive_mutex> locker( m_locker );
+    if ( !containsBuffer( name ) && !containsThemeItem( name ) ) {
+      addBuffer( name, data, priority );
+    } else if ( m_buffers.value( name ) != data ) {
+      m_buffers[ name ] = data;
+      itemsChanged( QStringList { name } );
+    }
+  }
+  void remove(const QString &path)
+  {
+    std::lock_guard<std::recursive_mutex> locker( m_locker );
+    if ( !containsThemeItem( path ) ) {
+      m_buffers.remove( path );
+      m_resources.remove( path );
+    }
+    m_cache.remove( path );
+
+    for ( auto &item: m_pending ) {
+      if ( item.path == path ) {
+        m_pending.removeOne( item );
+        break;
+      }
+    }
+
+    for ( auto &item: m_items ) {
+      if ( item.path == path ) {
+        m_items.removeOne( item );
+        break;
+      }
+    }
+
+    unwatch( path );
+  }
+
+  void addThemeItem(const QString &theme, Item::Type type, const QString &path)
+  {
+    std::lock_guard<std::recursive_mutex> locker( m_locker );
+    auto &t = m_themes[ theme ];
+    for ( auto &item: t.items )
+      if ( item.type == type && item.path == path )
+        return;
+
+    t.items << Item { type, path };
+    t.ready = false;
+    t.job.reset();
+    watch( t.items.last() );
+
+    if ( theme == m_theme )
+      reloadAllStylePrivate();
+    else
+      refreshThemes();
+  }
+  void removeTheme(const QString &theme)
+  {
+    std::lock_guard<std::recursive_mutex> locker( m_locker );
+    if ( !m_themes.contains( theme ) )
+      return;
+
+    if ( theme == m_theme )
+      setTheme( QString() );
+
+    auto items = m_themes.take( theme ).items;
+    for ( auto &item: items ) {
+      if ( !contains( item.path ) && !containsThemeItem( item.path ) ) {
+        m_buffers.remove( item.path );
+        m_resources.remove( item.path );
+      }
+      unwatch( item.path );
+    }
+  }
+  void setTheme(const QString &theme)
+  {
+    std::lock_guard<std::recursive_mutex> locker( m_locker );
+    if ( theme == m_theme || ( !theme.isEmpty() && !m_themes.contains( theme ) ) )
+      return;
+
+    m_theme = theme;
+    if ( m_sharedReader ) {
+      // The theme is part of the manifest, the owner may not have it
+      reloadAllStyle();
+      emit m_root->themeChanged( theme );
+      return;
+    }
+
+    if ( !theme.isEmpty() ) {
+      auto &t = m_themes[ theme ];
+      takeThemeJob( t );
+      if ( !t.ready )
+        assembleTheme( t );
+    }
+
+    applyStyleSheet( assembleStyleSheet() );
+    emit m_root->themeChanged( theme );
+  }
+  void setBackgroundThemeLoading(bool enable)
+  {
+    std::lock_guard<std::recursive_mutex> locker( m_locker );
+    m_backgroundThemes = enable;
+  }
+  void setPaletteBaking(bool enable)
+  {
+    std::lock_guard<std::recursive_mutex> locker( m_locker );
+    if ( m_paletteBaking != enable ) {
+      m_paletteBaking = enable;
+      applyStyleSheet( m_styleSheet, true );
+    }
+  }
+  void setLazyPartitioning(bool enable)
+  {
+    std::lock_guard<std::recursive_mutex> locker( m_locker );
+    if ( m_lazyPartitioning == enable )
+      return;
+
+    m_lazyPartitioning = enable;
+    if ( m_lazyPartitioning ) {
+      m_partition.reset();
+      qApp->installEventFilter( this );
+    } else {
+      qApp->removeEventFilter( this );
+    }
+    applyStyleSheet( m_styleSheet, true );
+  }
+  void setPolishProfiling(bool enable)
+  {
+    std::lock_guard<std::recursive_mutex> locker( m_locker );
+    if ( m_profiling == enable )
+      return;
+
+    m_profiling = enable;
+    if ( m_profiling )
+      updateSelectors( QStyleSheetRule::parse( m_styleSheet ) );
+    else
+      m_selectors.clear();
+
+    for ( auto updater: m_updaters )
+      updater->setPolishProfiling( enable );
+  }
+
+  bool listen(const QString &name)
+  {
+    std::lock_guard<std::recursive_mutex> locker( m_locker );
+    stopListening();
+#ifdef QT_NETWORK_LIB
+    auto server = new QStyleLoaderPushServer( [this](quint8 kind, const QString &item, const QByteArray &data) {
+      pushed( kind, item, data );
+    }, this );
+
+    if ( !server->listen( name ) ) {
+      delete server;
+      return false;
+    }
+    m_server = server;
+    return true;
+#else
+    Q_UNUSED( name );
+    return false;
+#endif
+  }
+  void stopListening()
+  {
+    std::lock_guard<std::recursive_mutex> locker( m_locker );
+#ifdef QT_NETWORK_LIB
+    delete m_server;
+    m_server = nullptr;
+#endif
+  }
+
+  bool setSharedCache(const QString &key, int capacity)
+  {
+    std::lock_guard<std::recursive_mutex> locker( m_locker );
+    if ( m_shared ) {
+      m_shared.reset();
+      killTimer( m_sharedTimer );
+      m_sharedTimer = 0;
+      if ( m_sharedReader ) {
+        leaveSharedReader();
+        reloadAllStyle();
+      }
+    }
+
+    if ( key.isEmpty() )
+      return true;
+
+    std::unique_ptr<QStyleLoaderSharedCache> shared ( new QStyleLoaderSharedCache( key ) );
+    if ( !shared->open( capacity ) )
+      return false;
+
+    m_shared = std::move( shared );
+    m_sharedVersion = 0;
+    m_sharedTimer = startTimer( 250 );
+
+    if ( m_shared->isOwner() ) {
+      if ( !m_lastReloaded.isNull() )
+        m_shared->publish( manifest(), m_styleSheet.toUtf8() );
+    } else {
+      syncShared();
+    }
+    return true;
+  }
+
+  QStyleUpdater *addUpdater(QWidget *widget)
+  {
+    std::lock_guard<std::recursive_mutex> locker( m_locker );
+    return insertUpdater( widget );
+  }
+  QStyleUpdater *addUpdater(QWidget *widget, const QString &profile)
+  {
+    std::lock_guard<std::recursive_mutex> locker( m_locker );
+    auto updater = insertUpdater( widget );
+    auto holder = m_profiles.value( profile );
+    if ( holder )
+      updater->ptr->setConfig( holder );
+    else
+      qWarning() << "QStyleLoader: unknown updater profile" << profile;
+    return updater;
+  }
+  void setProfile(const QString &name, const QStyleUpdater::Profile &profile)
+  {
+    std::lock_guard<std::recursive_mutex> locker( m_locker );
+    auto &holder = m_profiles[ name ];
+    if ( !holder ) {
+      holder = std::make_shared<QStyleUpdaterConfigHolder>();
+      holder->profile = name;
+    }
+
+    // Every updater of the profile reads the new configuration from now on
+    holder->config = std::make_shared<QStyleUpdaterConfig>( profile );
+    if ( profile.repolishBudget == 0 )
+      for ( auto updater: m_updaters )
+        updater->ptr->configChanged();
+  }
+  bool removeProfile(const QString &name)
+  {
+    std::lock_guard<std::recursive_mutex> locker( m_locker );
+    auto holder = m_profiles.take( name );
+    if ( !holder )
+      return false;
+
+    holder->profile.clear();
+    return true;
+  }
+  void removeUpdater(QWidget *widget)
+  {
+    std::lock_guard<std::recursive_mutex> locker( m_locker );
+    for ( auto updater: m_updaters ) {
+      if ( updater->widget() == widget ) {
+        auto u = updater;
+        m_updaters.removeOne( updater );
+        delete u;
+      }
+    }
+  }
+  QStyleUpdater *insertUpdater(QWidget *widget)
+  {
+    std::lock_guard<std::recursive_mutex> locker( m_locker );
+    for ( auto updater: m_updaters )
+      if ( updater->widget() == widget )
+        return updater;
+
+    auto updater = new QStyleUpdater( widget, this );
+    updater->setPaintOnlyProperties( m_paintOnlyProperties );
+    connect( updater, &QStyleUpdater::styleReloaded, this, &_QStyleLoader::updaterStyleReloaded );
+    connect( updater, &QStyleUpdater::styleProfiled, this, &_QStyleLoader::updaterStyleProfiled );
+    updater->setPolishProfiling( m_profiling );
+    if ( m_batchDepth > 0 )
+      updater->beginBatch();
+    m_updaters << updater;
+    return updater;
+  }
+
+  void reloadAllStyle()
+  {
+    std::lock_guard<std::recursive_mutex> locker( m_locker );
+    if ( m_shared && !m_shared->isOwner() && syncShared() ) {
+      m_hasReload = false;
+      return;
+    }
+
+    m_hasReload = false;
+    m_lastReloaded = QDateTime::currentDateTime();
+    m_pending.clear();
+
+    // Critical items and items that are already on screen are reloaded
+    // right away, the rest waits for the idle slices of the event loop.
+    for ( auto item: m_items ) {
+      if ( item.priority == Item::Priority::Critical || m_cache.contains( item.path ) )
+        m_cache[ item.path ] = loadItem( item );
+      else
+        m_pending << item;
+    }
+
+    std::stable_sort( m_pending.begin(), m_pending.end(), [](const Item &a, const Item &b) {
+      return a.priority < b.priority;
+    });
+
+    if ( m_themes.contains( m_theme ) )
+      assembleTheme( m_themes[ m_theme ] );
+
+    applyStyleSheet( assembleStyleSheet() );
+
+    if ( !m_pending.isEmpty() && !m_pendingTimer )
+      m_pendingTimer = startTimer( 0 );
+  }
+  void setAutoReloadStyle(bool enable)
+  {
+    std::lock_guard<std::recursive_mutex> locker( m_locker );
+    m_autoReload = enable;
+  }
+  void setFileFilters(const QStringList &include, const QStringList &exclude)
+  {
+    std::lock_guard<std::recursive_mutex> locker( m_locker );
+    if ( include == m_filter.include() && exclude == m_filter.exclude() )
+      return;
+
+    // Every directory guard rescans once and reports the difference
+    m_filter = QStyleLoaderFileFilter( include, exclude );
+    for ( auto guard: m_guards ) {
+      auto directory = dynamic_cast<QStyleLoaderDirectoryGuard*>( guard );
+      if ( directory )
+        directory->setFilter( m_filter );
+    }
+  }
+
+private slots:
+  void reloadAllStylePrivate()
+  {
+    std::lock_guard<std::recursive_mutex> locker( m_locker );
+    if ( autoReloadStyle() ) {
+      if ( m_batchDepth > 0 ) {
+        m_hasReload = true;
+      } else if ( m_lastReloaded.isNull() || m_lastReloaded.msecsTo( QDateTime::currentDateTime() ) > 2000 ) {
+        reloadAllStyle();
+      } else {
+        m_hasReload = true;
+      }
+    }
+  }
+
+  QString assembleStyleSheet() const
+  {
+    if ( m_hasSheetOverride )
+      return m_sheetOverride;
+
+    QStringList items;
+    for ( auto &item: m_items ) {
+      auto data = m_overrides.contains( item.path )
+          ? m_overrides.value( item.path )
+          : m_cache.value( item.path );
+      if ( !data.isEmpty() )
+        items << data;
+    }
+
+    // Pushed bodies of unknown items follow the loaded ones
+    for ( auto it = m_overrides.begin(); it != m_overrides.end(); ++it )
+      if ( !contains( it.key() ) && !it.value().isEmpty() )
+        items << it.value();
+
+    // The theme follows the common items, so its rules win
+    auto theme = m_themes.value( m_theme ).styleSheet;
+    if ( !theme.isEmpty() )
+      items << theme;
+
+    return items.join( '\n' );
+  }
+
+  void assembleTheme(Theme &theme)
+  {
+    QStringList items;
+    for ( auto &item: theme.items ) {
+      auto data = loadItem( item );
+      if ( !data.isEmpty() )
+        items << data;
+    }
+
+    theme.styleSheet = items.join( '\n' );
+    theme.ready = true;
+    theme.job.reset();
+  }
+
+  void takeThemeJob(Theme &theme)
+  {
+    if ( theme.job && theme.job->done.load( std::memory_order_acquire ) ) {
+      theme.styleSheet = theme.job->styleSheet;
+      theme.ready = true;
+      theme.job.reset();
+    }
+  }
+
+  ///
+  /// Brings inactive themes up to date, so that switching to them
+  /// applies an already assembled sheet without any I/O.
+  ///
+  void refreshThemes()
+  {
+    for ( auto it = m_themes.begin(); it != m_themes.end(); ++it ) {
+      auto &theme = it.value();
+      takeThemeJob( theme );
+      if ( theme.ready || it.key() == m_theme )
+        continue;
+
+      if ( !m_backgroundThemes ) {
+        assembleTheme( theme );
+      } else if ( !theme.job ) {
+        theme.job = std::make_shared<QStyleLoaderThemeJob::State>();
+        theme.job->filter = m_filter;
+        for ( auto &item: theme.items )
+          theme.job->items << qMakePair( item, m_buffers.value( item.path ) );
+        QThreadPool::globalInstance()->start( new QStyleLoaderThemeJob( theme.job ) );
+      }
+    }
+  }
+
+  bool containsThemeItem(const QString &path) const
+  {
+    for ( auto &theme: m_themes )
+      for ( auto &item: theme.items )
+        if ( item.path == path )
+          return true;
+    return false;
+  }
+
+  static bool covers(const Item &item, const QString &path)
+  {
+    auto itemPath = QDir::fromNativeSeparators( item.path );
+    if ( item.type == Item::Type::Directory )
+      return path.startsWith( QDir( itemPath ).absolutePath() + '/' );
+    return itemPath == path;
+  }
+
+  void watch(const Item &item)
+  {
+    // Files of a shared sheet are watched by its owner
+    if ( m_sharedReader || m_guards.contains( item.path ) )
+      return;
+
+    if ( item.type == Item::Type::File )
+      m_guards[ item.path ] = new QStyleLoaderFileGuard( QDir::fromNativeSeparators( item.path ),
+                                                         this,
+                                                         this );
+    else if ( item.type == Item::Type::Directory )
+      m_guards[ item.path ] = new QStyleLoaderDirectoryGuard( QDir::fromNativeSeparators( item.path ),
+                                                              m_filter,
+                                                              this,
+                                                              this );
+  }
+
+  void unwatch(const QString &path)
+  {
+    if ( m_guards.contains( path ) && !contains( path ) && !containsThemeItem( path ) )
+      delete m_guards.take( path );
+  }
+
+  ///
+  /// Reloads the applied sheet only when the changed paths belong to the
+  /// common items or to the current theme, other themes are refreshed.
+  ///
+  void itemsChanged(const QStringList &paths)
+  {
+    auto active = false;
+    QList<Item> critical;
+    for ( auto &path: paths ) {
+      for ( auto &item: m_items ) {
+        if ( covers( item, path ) ) {
+          // The saved file wins over a pushed body
+          m_overrides.remove( item.path );
+          if ( item.priority != Item::Priority::Critical )
+            active = true;
+          else if ( !critical.contains( item ) )
+            critical << item;
+        }
+      }
+
+      for ( auto it = m_themes.begin(); it != m_themes.end(); ++it ) {
+        for ( auto &item: it.value().items ) {
+          if ( covers( item, path ) ) {
+            it.value().ready = false;
+            it.value().job.reset();
+            if ( it.key() == m_theme )
+              active = true;
+          }
+        }
+      }
+    }
+
+    if ( !critical.isEmpty() )
+      reloadCriticalItems( critical );
+    if ( active )
+      reloadAllStylePrivate();
+  }
+
+  void itemAdded(const Item &item)
+  {
+    if ( item.priority == Item::Priority::Critical )
+      reloadCriticalItems( QList<Item> { item } );
+    else
+      reloadAllStylePrivate();
+  }
+
+  ///
+  /// Critical items are loaded and applied right away, without the reload throttle
+  ///
+  void reloadCriticalItems(const QList<Item> &items)
+  {
+    if ( !autoReloadStyle() )
+      return;
+
+    if ( m_batchDepth > 0 ) {
+      m_hasReload = true;
+    } else if ( m_lastReloaded.isNull() || ( m_shared && !m_shared->isOwner() ) ) {
+      // The first reload schedules the other layers, a shared reader checks the manifest
+      reloadAllStyle();
+    } else {
+      for ( auto &item: items )
+        m_cache[ item.path ] = loadItem( item );
+      applyStyleSheet( assembleStyleSheet() );
+    }
+  }
+
+  ///
+  /// Applies the assembled sheet. An unchanged sheet is skipped unless forced,
+  /// which the baking and partitioning switches need to re-apply it.
+  ///
+  void applyStyleSheet(const QString &styleSheet, bool force = false)
+  {
+    if ( !force && styleSheet == m_styleSheet ) {
+      // The sources may change without changing the sheet
+      if ( m_shared && m_shared->isOwner() )
+        m_shared->publish( manifest(), styleSheet.toUtf8() );
+      return;
+    }
+
+    m_styleSheet = styleSheet;
+    auto rules = QStyleSheetRule::parse( styleSheet );
+
+    auto applied = styleSheet;
+    if ( m_paletteBaking ) {
+      if ( !m_paletteBaked ) {
+        m_basePalette = QApplication::palette();
+        m_paletteBaked = true;
+      }
+      // An empty sheet keeps the native style, without the style sheet style
+      applied = QStyleLoaderPaletteBaker::bake( rules, m_basePalette );
+    } else if ( m_paletteBaked ) {
+      QApplication::setPalette( m_basePalette );
+      m_paletteBaked = false;
+    }
+
+    // Baked rules are gone, only the rest of the sheet is partitioned
+    if ( m_lazyPartitioning ) {
+      m_partition.setStyleSheet( applied );
+      applyPartition();
+    } else {
+      qApp->setStyleSheet( applied );
+    }
+
+    updatePaintOnlyProperties( rules );
+    if ( m_profiling )
+      updateSelectors( rules );
+    if ( m_shared && m_shared->isOwner() )
+      m_shared->publish( manifest(), styleSheet.toUtf8() );
+    emit m_root->styleApplied();
   }
-  void addFile(const QString &path)
+
+  ///
+  /// Applies the global rules and the rules of the active classes. Widgets
+  /// polished while the sheet is set can activate more classes, they are
+  /// applied by the same call.
+  ///
+  void applyPartition()
   {
-    std::lock_guard<std::recursive_mutex> locker( m_locker );
-    if ( !containsFile( path ) ) {
-      m_items << Item { Item::Type::File, path };
-      m_guards[ path ] = new QStyleLoaderFileGuard( QDir::fromNativeSeparators( path ),
-                                                    this,
-                                                    this );
-      reloadAllStylePrivate();
+    if ( m_partitionApplying ) {
+      m_partitionPending = true;
+      return;
     }
+
+    m_partitionApplying = true;
+    do {
+      m_partitionPending = false;
+      qApp->setStyleSheet( m_partition.styleSheet() );
+    } while ( m_partitionPending );
+    m_partitionApplying = false;
   }
-  void addDirectory(const QString &path)
+
+  ///
+  /// Sources of the assembled sheet. Processes with the same manifest
+  /// can use the sheet published by the owner of the shared cache.
+  ///
+  QByteArray manifest() const
   {
-    std::lock_guard<std::recursive_mutex> locker( m_locker );
-    if ( !containsDirectory( path ) ) {
-      m_items << Item { Item::Type::Directory, path };
-      m_guards[ path ] = new QStyleLoaderDirectoryGuard( QDir::fromNativeSeparators( path ),
-                                                         m_filter,
-                                                         this,
-                                                         this );
-      reloadAllStylePrivate();
-    }
+    auto digest = [](const QByteArray &data) {
+      return QString::fromLatin1( QCryptographicHash::hash( data, QCryptographicHash::Md5 ).toHex() );
+    };
+    auto line = [this, &digest](const Item &item) {
+      auto path = item.type == Item::Type::File || item.type == Item::Type::Directory
+          ? QFileInfo( item.path ).absoluteFilePath()
+          : item.path;
+      auto data = item.type == Item::Type::Buffer ? digest( m_buffers.value( item.path ) ) : QString();
+      return QString( "%1\t%2\t%3" ).arg( int( item.type ) ).arg( path, data );
+    };
+
+    QStringList lines;
+    for ( auto &item: m_items )
+      lines << line( item );
+
+    lines << "theme\t" + m_theme;
+    for ( auto &item: m_themes.value( m_theme ).items )
+      lines << line( item );
+
+    lines << "include\t" + m_filter.include().join( ' ' );
+    lines << "exclude\t" + m_filter.exclude().join( ' ' );
+
+    for ( auto it = m_overrides.begin(); it != m_overrides.end(); ++it )
+      lines << "override\t" + it.key() + '\t' + digest( it.value().toUtf8() );
+    if ( m_hasSheetOverride )
+      lines << "sheet\t" + digest( m_sheetOverride.toUtf8() );
+
+    return lines.join( '\n' ).toUtf8();
   }
-  void remove(const QString &path)
+
+  ///
+  /// Applies the published sheet when it was assembled from the same sources,
+  /// otherwise the loader goes back to watching and loading its own files.
+  ///
+  bool syncShared()
   {
-    std::lock_guard<std::recursive_mutex> locker( m_locker );
-    if ( m_guards.contains( path ) ) {
-      auto obj = m_guards[ path ];
-      m_guards.remove( path );
-      delete obj;
+    quint64 version = 0;
+    QByteArray manifest, sheet;
+    if ( !m_shared || m_shared->isOwner() || !m_shared->read( version, manifest, sheet ) )
+      return false;
+
+    m_sharedVersion = version;
+    if ( version == 0 || manifest != this->manifest() ) {
+      if ( m_sharedReader )
+        leaveSharedReader();
+      return false;
     }
 
-    for ( auto &item: m_items ) {
-      if ( item.path == path ) {
-        m_items.removeOne( item );
-        break;
+    if ( !m_sharedReader ) {
+      m_sharedReader = true;
+      m_styleSheet.clear();
+      qDeleteAll( m_guards );
+      m_guards.clear();
+      m_pending.clear();
+      if ( m_pendingTimer ) {
+        killTimer( m_pendingTimer );
+        m_pendingTimer = 0;
       }
     }
+
+    auto styleSheet = QString::fromUtf8( sheet );
+    if ( styleSheet != m_styleSheet )
+      applyStyleSheet( styleSheet );
+    return true;
   }
 
-  QStyleUpdater *addUpdater(QWidget *widget)
+  void leaveSharedReader()
   {
-    std::lock_guard<std::recursive_mutex> locker( m_locker );
-    return insertUpdater( widget );
+    m_sharedReader = false;
+    for ( auto &item: m_items )
+      watch( item );
+    for ( auto &theme: m_themes )
+      for ( auto &item: theme.items )
+        watch( item );
   }
-  void removeUpdater(QWidget *widget)
+
+  void sharedTick()
   {
     std::lock_guard<std::recursive_mutex> locker( m_locker );
-    for ( auto updater: m_updaters ) {
-      if ( updater->widget() == widget ) {
-        auto u = updater;
-        m_updaters.removeOne( updater );
-        delete u;
-      }
+    // A segment that is still being created is checked again on the next tick
+    auto owner = m_shared->isOwner();
+    if ( !m_shared->isReady( 3000 ) )
+      return;
+    if ( !owner && m_shared->isOwner() ) {
+      m_shared->publish( manifest(), m_styleSheet.toUtf8() );
+      return;
     }
-  }
-  QStyleUpdater *insertUpdater(QWidget *widget)
-  {
-    std::lock_guard<std::recursive_mutex> locker( m_locker );
-    for ( auto updater: m_updaters )
-      if ( updater->widget() == widget )
-        return updater;
 
-    auto updater = new QStyleUpdater( widget, this );
-    connect( updater, &QStyleUpdater::styleReloaded, this, &_QStyleLoader::updaterStyleReloaded );
-    m_updaters << updater;
-    return updater;
+    if ( m_shared->heartbeat() )
+      return;
+
+    // This process does the I/O and the watching from now on
+    if ( m_shared->takeOver( 3000 ) ) {
+      if ( m_sharedReader )
+        leaveSharedReader();
+      reloadAllStyle();
+      return;
+    }
+
+    if ( m_shared->version() != m_sharedVersion ) {
+      auto reader = m_sharedReader;
+      if ( !syncShared() && reader )
+        reloadAllStyle();
+    }
   }
 
-  void reloadAllStyle()
+  void updateSelectors(const QList<QStyleSheetRule> &rules)
   {
-    std::lock_guard<std::recursive_mutex> locker( m_locker );
-    m_hasReload = false;
-    m_lastReloaded = QDateTime::currentDateTime();
-    QStringList items;
+    m_selectors.clear();
+    for ( auto &rule: rules )
+      for ( auto &selector: rule.selectors )
+        m_selectors << qMakePair( selector, QStyleSheetSelector::parse( selector ) );
+  }
 
-    for ( auto item: m_items ) {
-      auto data = loadItem( item );
-      if ( !data.isEmpty() )
-        items << data;
+  void updatePaintOnlyProperties(const QList<QStyleSheetRule> &rules)
+  {
+    // A property is paint-only when every rule that selects
+    // on it changes nothing but colors, borders or backgrounds.
+    QSet<QString> paint, geometry;
+    for ( auto &rule: rules ) {
+      auto paintOnly = rule.isPaintOnly();
+      for ( auto &name: rule.attributes() )
+        ( paintOnly ? paint : geometry ).insert( name );
     }
 
-    qApp->setStyleSheet( items.join( '\n' ) );
+    m_paintOnlyProperties = paint.subtract( geometry ).toList();
+    for ( auto updater: m_updaters )
+      updater->setPaintOnlyProperties( m_paintOnlyProperties );
   }
-  void setAutoReloadStyle(bool enable)
+
+  void loadPendingItem()
   {
     std::lock_guard<std::recursive_mutex> locker( m_locker );
-    m_autoReload = enable;
+    if ( !m_pending.isEmpty() ) {
+      auto item = m_pending.takeFirst();
+      m_cache[ item.path ] = loadItem( item );
+
+      // The whole layer is loaded
+      if ( m_pending.isEmpty() || m_pending.first().priority != item.priority )
+        applyStyleSheet( assembleStyleSheet() );
+    }
+
+    if ( m_pending.isEmpty() && m_pendingTimer ) {
+      killTimer( m_pendingTimer );
+      m_pendingTimer = 0;
+    }
   }
 
-private slots:
-  void reloadAllStylePrivate()
+  void pushed(quint8 kind, const QString &item, const QByteArray &data)
   {
     std::lock_guard<std::recursive_mutex> locker( m_locker );
-    if ( autoReloadStyle() ) {
-      if ( m_lastReloaded.isNull() || m_lastReloaded.msecsTo( QDateTime::currentDateTime() ) > 2000 ) {
-        reloadAllStyle();
-      } else {
-        m_hasReload = true;
-      }
+    switch ( kind ) {
+      case PushItem:
+        m_overrides[ item ] = QString::fromUtf8( data );
+        break;
+      case PushSheet:
+        m_sheetOverride = QString::fromUtf8( data );
+        m_hasSheetOverride = true;
+        break;
+      case PushReset:
+        if ( item.isEmpty() ) {
+          m_overrides.clear();
+          m_sheetOverride.clear();
+          m_hasSheetOverride = false;
+        } else {
+          m_overrides.remove( item );
+        }
+        break;
+      default:
+        return;
     }
+
+    // Bursts of pushes are applied once after the last one, bypassing the reload throttle
+    if ( m_pushTimer )
+      killTimer( m_pushTimer );
+    m_pushTimer = startTimer( 50 );
   }
 
   void updaterStyleReloaded(QWidget *widget)
@@ -780,46 +3880,51 @@ private slots:
       emit m_root->styleReloaded( updater, widget );
   }
 
-  QString loadItem(const Item &item)
+  void updaterStyleProfiled(QWidget *widget, qint64 nsecs)
   {
-    if ( item.type == Item::Type::File )
-      return loadFile( item.path );
-    return loadDirectory( item.path );
+    std::lock_guard<std::recursive_mutex> locker( m_locker );
+    auto &stat = m_polishStats[ statKey( widget ) ];
+    if ( stat.count == 0 ) {
+      stat.className = QString::fromLatin1( widget->metaObject()->className() );
+      stat.objectName = widget->objectName();
+    }
+    ++stat.count;
+    stat.nsecs += nsecs;
+
+    for ( auto &selector: m_selectors ) {
+      if ( !selector.second.matches( widget ) )
+        continue;
+      auto &rule = m_ruleStats[ selector.first ];
+      rule.selector = selector.first;
+      ++rule.count;
+      rule.nsecs += nsecs;
+    }
   }
 
-  QString loadFile(const QString &path)
+  QString loadItem(const Item &item)
   {
-    QString result;
-    QFile f ( QDir::fromNativeSeparators( path ) );
-    if ( f.open( QIODevice::ReadOnly ) ) {
-      result = QString::fromUtf8( f.readAll() );
-      f.close();
-    } else {
-      qDebug() << f.errorString();
+    switch ( item.type ) {
+      case Item::Type::File:      return loadFile( item.path );
+      case Item::Type::Directory: return loadDirectory( item.path );
+      case Item::Type::Buffer:    return QString::fromUtf8( m_buffers.value( item.path ) );
+      case Item::Type::Resource:
+        if ( !m_resources.contains( item.path ) )
+          m_resources[ item.path ] = QFileInfo( item.path ).isDir()
+              ? loadDirectory( item.path )
+              : loadFile( item.path );
+        return m_resources.value( item.path );
     }
+    return QString();
+  }
 
-    return result;
+  QString loadFile(const QString &path)
+  {
+    return loadStyleFile( path );
   }
 
   QString loadDirectory(const QString &path)
   {
-    QStringList result;
-    QDir directory ( path );
-
-    for ( auto &f: directory.entryInfoList( m_filter, QDir::Filter::Files ) ) {
-      auto data = loadFile( f.absoluteFilePath() );
-      if ( !data.isEmpty() )
-        result << data;
-    }
-
-    for ( auto &name: directory.entryList( m_filter, QDir::Filter::Dirs ) ) {
-      if ( name == ".." || name == "." ) continue;
-      auto data = loadDirectory( directory.absoluteFilePath( name ) );
-      if ( !data.isEmpty() )
-        result << data;
-    }
-
-    return result.join( '\n' );
+    return loadStyleDirectory( path, m_filter );
   }
 
   // QStyleLoaderGuardObserver
@@ -827,32 +3932,76 @@ public:
   virtual void added(const QString &path) override
   {
     m_root->fileStyleChanged( path );
-    reloadAllStylePrivate();
+    itemsChanged( QStringList { path } );
   }
   virtual void removed(const QString &path) override
   {
     m_root->fileStyleChanged( path );
-    reloadAllStylePrivate();
+    itemsChanged( QStringList { path } );
   }
   virtual void changed(const QString &path) override
   {
     m_root->fileStyleChanged( path );
-    reloadAllStylePrivate();
+    itemsChanged( QStringList { path } );
+  }
+  virtual void updated(const QStringList &added, const QStringList &removed, const QStringList &changed) override
+  {
+    auto paths = added + removed + changed;
+    for ( auto &path: paths )
+      m_root->fileStyleChanged( path );
+    itemsChanged( paths );
   }
 
   // QObject interface
 protected:
+  bool eventFilter(QObject *watched, QEvent *event) override
+  {
+    // The filter runs before QWidget::event polishes the widget with the style
+    if ( event->type() == QEvent::Polish && watched->isWidgetType() ) {
+      auto widget = static_cast<QWidget*>( watched );
+      QList<QWidget*> widgets { widget };
+      // A window is polished before its children, they are activated with it
+      if ( widget->isWindow() )
+        widgets += widget->findChildren<QWidget*>();
+
+      std::lock_guard<std::recursive_mutex> locker( m_locker );
+      if ( m_partition.activate( widgets ) )
+        applyPartition();
+    }
+    return QObject::eventFilter( watched, event );
+  }
   void timerEvent(QTimerEvent *event) override
   {
-    reloadAllStylePrivate();
+    if ( event->timerId() == m_pendingTimer )
+      loadPendingItem();
+    else if ( event->timerId() == m_pushTimer ) {
+      std::lock_guard<std::recursive_mutex> locker( m_locker );
+      killTimer( m_pushTimer );
+      m_pushTimer = 0;
+      // Pushed styles change the manifest, a reader loads its own files
+      if ( m_sharedReader )
+        reloadAllStyle();
+      else
+        applyStyleSheet( assembleStyleSheet() );
+    }
+    else if ( event->timerId() == m_sharedTimer )
+      sharedTick();
+    else if ( event->timerId() == m_reloadTimer ) {
+      // The guards report every change, the timer only flushes throttled reloads
+      if ( m_hasReload && m_batchDepth == 0 )
+        reloadAllStylePrivate();
+      if ( !m_sharedReader )
+        refreshThemes();
+    }
     QObject::timerEvent( event );
   }
 
 };
 
-QStyleLoader::Item::Item(QStyleLoader::Item::Type type, const QString &path)
+QStyleLoader::Item::Item(QStyleLoader::Item::Type type, const QString &path, QStyleLoader::Item::Priority priority)
   : type( type )
   , path( path )
+  , priority( priority )
 {
 
 }
@@ -872,6 +4021,26 @@ bool QStyleLoader::Item::operator!=(const Item &item) const
   return type != item.type || path != item.path;
 }
 
+QStyleLoader::RuleStat::RuleStat()
+  : count( 0 )
+  , nsecs( 0 )
+{
+
+}
+
+QStyleLoader::Batch::Batch(QStyleLoader *loader)
+  : m_loader( loader )
+{
+  if ( m_loader )
+    m_loader->beginBatch();
+}
+
+QStyleLoader::Batch::~Batch()
+{
+  if ( m_loader )
+    m_loader->endBatch();
+}
+
 QStyleLoader::QStyleLoader(QObject *parent)
   : QObject( parent )
   , ptr ( new _QStyleLoader( this ) )
@@ -889,6 +4058,16 @@ QStyleLoader *QStyleLoader::instance()
   return instancePtr;
 }
 
+bool QStyleLoader::pushStyle(const QString &serverName, const QString &item, const QByteArray &data, int timeout)
+{
+  return sendPush( serverName, encodePush( item.isEmpty() ? PushSheet : PushItem, item, data ), timeout );
+}
+
+bool QStyleLoader::resetPushedStyle(const QString &serverName, const QString &item, int timeout)
+{
+  return sendPush( serverName, encodePush( PushReset, item, QByteArray() ), timeout );
+}
+
 int QStyleLoader::count() const
 {
   return ptr->count();
@@ -909,6 +4088,11 @@ QStringList QStyleLoader::fileFilters() const
   return ptr->fileFilters();
 }
 
+QStringList QStyleLoader::excludeFilters() const
+{
+  return ptr->excludeFilters();
+}
+
 bool QStyleLoader::contains(const QString &path) const
 {
   return ptr->contains( path );
@@ -924,6 +4108,21 @@ bool QStyleLoader::containsDirectory(const QString &path) const
   return ptr->containsDirectory( path );
 }
 
+bool QStyleLoader::containsBuffer(const QString &name) const
+{
+  return ptr->containsBuffer( name );
+}
+
+bool QStyleLoader::containsResource(const QString &path) const
+{
+  return ptr->containsResource( path );
+}
+
+QByteArray QStyleLoader::buffer(const QString &name) const
+{
+  return ptr->buffer( name );
+}
+
 QList<QStyleUpdater *> QStyleLoader::updaters() const
 {
   return ptr->updaters();
@@ -944,19 +4143,129 @@ bool QStyleLoader::autoReloadStyle() const
   return ptr->autoReloadStyle();
 }
 
-void QStyleLoader::add(QStyleLoader::Item::Type type, const QString &path)
+QStringList QStyleLoader::paintOnlyProperties() const
+{
+  return ptr->paintOnlyProperties();
+}
+
+QStringList QStyleLoader::themes() const
+{
+  return ptr->themes();
+}
+
+QString QStyleLoader::theme() const
+{
+  return ptr->theme();
+}
+
+QList<QStyleLoader::Item> QStyleLoader::themeItems(const QString &theme) const
+{
+  return ptr->themeItems( theme );
+}
+
+bool QStyleLoader::backgroundThemeLoading() const
+{
+  return ptr->backgroundThemeLoading();
+}
+
+QString QStyleLoader::styleSheet() const
+{
+  return ptr->styleSheet();
+}
+
+bool QStyleLoader::paletteBaking() const
+{
+  return ptr->paletteBaking();
+}
+
+bool QStyleLoader::lazyPartitioning() const
+{
+  return ptr->lazyPartitioning();
+}
+
+bool QStyleLoader::isListening() const
+{
+  return ptr->isListening();
+}
+
+QString QStyleLoader::serverName() const
+{
+  return ptr->serverName();
+}
+
+bool QStyleLoader::polishProfiling() const
+{
+  return ptr->polishProfiling();
+}
+
+QStringList QStyleLoader::profiles() const
+{
+  return ptr->profiles();
+}
+
+QStyleUpdater::Profile QStyleLoader::profile(const QString &name) const
+{
+  return ptr->profile( name );
+}
+
+QList<QStyleUpdater::PolishStat> QStyleLoader::polishStats(int top) const
+{
+  return ptr->polishStats( top );
+}
+
+QList<QStyleLoader::RuleStat> QStyleLoader::ruleStats(int top) const
+{
+  return ptr->ruleStats( top );
+}
+
+void QStyleLoader::clearPolishStats()
+{
+  ptr->clearPolishStats();
+}
+
+bool QStyleLoader::isBatchActive() const
+{
+  return ptr->isBatchActive();
+}
+
+void QStyleLoader::beginBatch()
+{
+  ptr->beginBatch();
+}
+
+void QStyleLoader::endBatch()
+{
+  ptr->endBatch();
+}
+
+void QStyleLoader::add(QStyleLoader::Item::Type type, const QString &path, QStyleLoader::Item::Priority priority)
+{
+  ptr->add( type, path, priority );
+}
+
+void QStyleLoader::addFile(const QString &path, QStyleLoader::Item::Priority priority)
+{
+  ptr->addFile( path, priority );
+}
+
+void QStyleLoader::addDirectory(const QString &path, QStyleLoader::Item::Priority priority)
 {
-  ptr->add( type, path );
+  ptr->addDirectory( path, priority );
 }
 
-void QStyleLoader::addFile(const QString &path)
+void QStyleLoader::addResource(const QString &path, QStyleLoader::Item::Priority priority)
 {
-  ptr->addFile( path );
+  ptr->addResource( path, priority );
 }
 
-void QStyleLoader::addDirectory(const QString &path)
+void QStyleLoader::addBuffer(const QString &name, const QByteArray &data, Item::Priority priority)
 {
-  ptr->addDirectory( path );
+  ptr->addBuffer( name, data, priority );
+}
+
+void QStyleLoader::setBuffer(const QString &name, const QByteArray &data, Item::Priority priority)
+{
+  ptr->setBuffer( name, data, priority );
 }
 
 void QStyleLoader::remove(const QString &path)
@@ -979,6 +4288,21 @@ QStyleUpdater *QStyleLoader::insertUpdater(QWidget *widget)
   return ptr->insertUpdater( widget );
 }
 
+QStyleUpdater *QStyleLoader::addUpdater(QWidget *widget, const QString &profile)
+{
+  return ptr->addUpdater( widget, profile );
+}
+
+void QStyleLoader::setProfile(const QString &name, const QStyleUpdater::Profile &profile)
+{
+  ptr->setProfile( name, profile );
+}
+
+bool QStyleLoader::removeProfile(const QString &name)
+{
+  return ptr->removeProfile( name );
+}
+
 void QStyleLoader::reloadAllStyle()
 {
   ptr->reloadAllStyle();
@@ -988,3 +4312,63 @@ void QStyleLoader::setAutoReloadStyle(bool enable)
 {
   ptr->setAutoReloadStyle( enable );
 }
+
+void QStyleLoader::setFileFilters(const QStringList &filters)
+{
+  ptr->setFileFilters( filters, ptr->excludeFilters() );
+}
+
+void QStyleLoader::setExcludeFilters(const QStringList &filters)
+{
+  ptr->setFileFilters( ptr->fileFilters(), filters );
+}
+
+void QStyleLoader::setFileFilters(const QStringList &include, const QStringList &exclude)
+{
+  ptr->setFileFilters( include, exclude );
+}
+
+void QStyleLoader::addThemeItem(const QString &theme, QStyleLoader::Item::Type type, const QString &path)
+{
+  ptr->addThemeItem( theme, type, path );
+}
+
+void QStyleLoader::removeTheme(const QString &theme)
+{
+  ptr->removeTheme( theme );
+}
+
+void QStyleLoader::setTheme(const QString &theme)
+{
+  ptr->setTheme( theme );
+}
+
+void QStyleLoader::setBackgroundThemeLoading(bool enable)
+{
+  ptr->setBackgroundThemeLoading( enable );
+}
+
+void QStyleLoader::setPaletteBaking(bool enable)
+{
+  ptr->setPaletteBaking( enable );
+}
+
+void QStyleLoader::setLazyPartitioning(bool enable)
+{
+  ptr->setLazyPartitioning( enable );
+}
+
+bool QStyleLoader::listen(const QString &name)
+{
+  return ptr->listen( name );
+}
+
+void QStyleLoader::stopListening()
+{
+  ptr->stopListening();
+}
+
+void QStyleLoader::setPolishProfiling(bool enable)
+{
+  ptr->setPolishProfiling( enable );
+}
@@ -1,5 +1,7 @@
 ﻿#pragma once
 #include <QObject>
+#include <QPointer>
+#include <QVariant>
 #include <functional>
 
 ///
@@ -11,6 +13,71 @@ class QStyleUpdater final
   Q_OBJECT
   class _QStyleUpdater;
   _QStyleUpdater *ptr;
+  friend class QStyleLoader;
+public:
+  ///
+  /// \brief Scope of a batch property update
+  /// \details While the batch is open, changed widgets are not queued. Each of them
+  ///  is reloaded exactly once when the outermost batch is closed.
+  ///
+  class Batch
+  {
+    QPointer<QStyleUpdater> m_updater;
+  public:
+    explicit Batch(QStyleUpdater *updater);
+    ~Batch();
+  private:
+    Q_DISABLE_COPY(Batch)
+  };
+
+  ///
+  /// \brief Polish cost of the widgets of one class and object name
+  ///
+  struct PolishStat
+  {
+    QString className;
+    QString objectName;
+    int     count;
+    qint64  nsecs;
+
+    PolishStat();
+  };
+
+  ///
+  /// \brief Declarative filter of the tracked child widgets
+  /// \details Empty fields match every child. The filter is compiled once,
+  ///  the class check is cached per meta-object. An invalid object name pattern
+  ///  matches no child and prints a warning when the filter is set.
+  ///
+  struct ChildFilter
+  {
+    QStringList classNames;         ///< The child inherits one of the classes
+    QString     objectNamePattern;  ///< Wildcard pattern, or a regular expression
+    bool        regularExpression;  ///< objectNamePattern is a regular expression
+    QByteArray  requiredProperty;   ///< The child has the property
+    int         maxDepth;           ///< Levels below the tracked widget, unlimited when negative
+
+    ChildFilter();
+  };
+
+  ///
+  /// \brief Configuration shared by many updaters
+  /// \details Profiles are registered on QStyleLoader by name. The updaters of a
+  ///  profile share one immutable copy of it and follow its changes. Changing a
+  ///  setting of such an updater detaches it from the profile.
+  ///
+  struct Profile
+  {
+    QStringList                     properties;
+    bool                            refreshChildWidgets;
+    bool                            updateWithAllChanges;
+    ChildFilter                     childFilter;
+    std::function<bool(QWidget *)>  filter;
+    int                             repolishBudget;
+
+    Profile();
+  };
+
 public:
   QStyleUpdater(QWidget *widget = nullptr, QObject *parent = nullptr);
   QStyleUpdater(const QStringList &properties, QWidget *widget = nullptr, QObject *parent = nullptr);
@@ -38,6 +105,101 @@ public:
   ///
   bool updateWithAllChanges() const;
 
+  ///
+  /// \brief Properties whose changes only need a repaint
+  ///
+  QStringList paintOnlyProperties() const;
+
+  ///
+  /// \brief Declarative child filter
+  ///
+  ChildFilter childFilter() const;
+
+  ///
+  /// \brief Name of the shared profile, empty when the updater has its own settings
+  ///
+  QString profileName() const;
+
+  ///
+  /// \brief Current settings of the updater
+  ///
+  Profile profile() const;
+
+  ///
+  /// \brief Time budget of one repolish slice in msecs, 0 repolishes synchronously
+  ///
+  int repolishBudget() const;
+
+  ///
+  /// \brief Scheduled widgets wait for their repolish slice
+  ///
+  bool isRepolishing() const;
+
+  ///
+  /// \brief Batch update is open
+  ///
+  bool isBatchActive() const;
+
+  ///
+  /// \brief Opens a batch update, batches can be nested
+  ///
+  void beginBatch();
+
+  ///
+  /// \brief Closes a batch update and reloads the changed widgets
+  ///
+  void endBatch();
+
+  ///
+  /// \brief Sets a property of the widget, can be called from any thread
+  /// \details The value is put into a lock-free queue that is applied in the thread
+  ///  of the updater. Only the latest value of each property of the widget is set,
+  ///  the changed widgets are reloaded once per applied queue.
+  ///
+  ///  The call takes a guarded pointer to the widget in the calling thread, so the
+  ///  widget must outlive the call: the caller has to make sure the GUI thread does
+  ///  not destroy it meanwhile. A widget destroyed after the call is skipped.
+  /// \param widget
+  /// \param name
+  /// \param value
+  ///
+  void postProperty(QWidget *widget, const QByteArray &name, const QVariant &value);
+
+  ///
+  /// \brief Polish time of the reloaded widgets is measured
+  ///
+  bool polishProfiling() const;
+
+  ///
+  /// \brief Polish costs sorted from the most expensive
+  /// \param top Maximum count of the returned stats, all when negative
+  ///
+  QList<PolishStat> polishStats(int top = -1) const;
+
+  ///
+  /// \brief Clears the collected polish costs
+  ///
+  void clearPolishStats();
+
+  ///
+  /// \brief Tracked property changes are written into a recording
+  ///
+  bool isRecording() const;
+
+  ///
+  /// \brief Starts writing the tracked property changes into the file
+  /// \details Every change is stored with its time, the path of the widget,
+  ///  the property name and the new value. The recording can be replayed
+  ///  against a reconstructed widget tree with tools/qstyle_replay.
+  /// \return False when the file can not be opened
+  ///
+  bool startRecording(const QString &fileName);
+
+  ///
+  /// \brief Stops and closes the recording
+  ///
+  void stopRecording();
+
 public slots:
   ///
   /// \brief Force reload styles
@@ -87,11 +249,59 @@ public slots:
   ///
   void setChildFilter(const std::function<bool(QWidget *)> &filter);
 
+  ///
+  /// \brief Sets the declarative child filter
+  /// \details It is checked before the function filter, both have to accept the child.
+  /// \param filter
+  ///
+  void setChildFilter(const ChildFilter &filter);
+
+  ///
+  /// \brief Sets the properties whose changes only need a repaint
+  /// \details When all changed properties of a widget are paint-only, the widget
+  ///  is polished again without unpolish and without a new layout pass.
+  ///  The loader sets this list for its updaters after each reload.
+  /// \param list
+  ///
+  void setPaintOnlyProperties(const QStringList &list);
+
+  ///
+  /// \brief Enables measuring of the polish time of each reloaded widget
+  /// \details The costs are collected per class and object name,
+  ///  and reported for every widget by styleProfiled. Only repolishes done by
+  ///  the updater are timed, polishes done by Qt itself (first show, a new
+  ///  application style sheet) are not measured.
+  /// \param enable
+  ///
+  void setPolishProfiling(bool enable);
+
+  ///
+  /// \brief Sets the time budget of one repolish slice
+  /// \details With a budget, reloadStyle and the flushes of changed widgets only
+  ///  schedule the widgets. They are repolished in slices of about the budget,
+  ///  with the event loop running between the slices. The focused widget goes
+  ///  first, then the visible widgets and then the hidden ones.
+  ///  Setting the budget to 0 repolishes the scheduled widgets right away.
+  /// \param msecs
+  ///
+  void setRepolishBudget(int msecs);
+
 signals:
   ///
   /// \brief Style reloaded
   ///
   void styleReloaded(QWidget *widget);
+
+  ///
+  /// \brief Style of the widget reloaded in nsecs, emitted only while profiling
+  ///
+  void styleProfiled(QWidget *widget, qint64 nsecs);
+
+  ///
+  /// \brief All scheduled widgets are repolished
+  /// \details Emitted after the last slice, or after reloadStyle without a budget.
+  ///
+  void repolishFinished();
 };
 
 ///
@@ -102,26 +312,69 @@ class QStyleLoader final
 {
   Q_OBJECT
 public:
+  ///
+  /// \brief Scope of a batch update of all updaters and the style sheet
+  ///
+  class Batch
+  {
+    QPointer<QStyleLoader> m_loader;
+  public:
+    explicit Batch(QStyleLoader *loader);
+    ~Batch();
+  private:
+    Q_DISABLE_COPY(Batch)
+  };
+
   ///
   /// \brief Style loading elemen
   /// \details Used to find and automatically reload
   ///  styles when adding, modifying and deleting files.
+  ///  Buffer items hold a style sheet in memory (the path is the buffer name),
+  ///  Resource items are loaded once from a ":/" path and are never watched.
   ///
   struct Item
   {
     enum class Type
     {
-      File, Directory
+      File, Directory, Buffer, Resource
     };
-    Type    type;
-    QString path;
+    ///
+    /// \brief Loading layer of the item
+    /// \details Critical items are applied synchronously when they are added or
+    ///  changed, without the reload throttle. The other layers are loaded in idle
+    ///  slices of the event loop and applied layer by layer.
+    ///  The cascade order always follows the order of adding items.
+    ///
+    enum class Priority
+    {
+      Critical, Normal, Deferred
+    };
+    Type      type;
+    QString   path;
+    Priority  priority;
 
-    Item(Type type = Type::File, const QString &path = "");
+    Item(Type type = Type::File, const QString &path = "", Priority priority = Priority::Critical);
     ~Item();
 
     bool operator==(const Item &) const;
     bool operator!=(const Item &) const;
   };
+
+  ///
+  /// \brief Polish cost attributed to one selector of the applied sheet
+  /// \details A widget matches the selector when its class, object name and
+  ///  attributes match the subject of the selector. Pseudo-states and ancestors
+  ///  are not checked, so the attribution is approximate and the whole polish
+  ///  time of a widget is counted for every selector it matches.
+  ///
+  struct RuleStat
+  {
+    QString selector;
+    int     count;
+    qint64  nsecs;
+
+    RuleStat();
+  };
 private:
   class _QStyleLoader;
   _QStyleLoader *ptr;
@@ -132,34 +385,214 @@ public:
 public:
   static QStyleLoader *instance();
 
+  ///
+  /// \brief Sends a replacement body of the item to a listening loader
+  /// \details The body is applied instead of the loaded content of the item with
+  ///  the same path or buffer name, until the item changes on disk or the override
+  ///  is reset. Unknown names are applied after all items. With an empty item name
+  ///  the body replaces the whole assembled sheet.
+  /// \return False when the server is not reachable within the timeout
+  ///
+  static bool pushStyle(const QString &serverName, const QString &item, const QByteArray &data, int timeout = 1000);
+
+  ///
+  /// \brief Drops the pushed body of the item, or all pushed bodies for an empty name
+  ///
+  static bool resetPushedStyle(const QString &serverName, const QString &item = QString(), int timeout = 1000);
+
 public:
   int count() const;
   Item at(int index) const;
   QList<Item> items() const;
   QStringList fileFilters() const;
+  QStringList excludeFilters() const;
   bool contains(const QString &path) const;
   bool containsFile(const QString &path) const;
   bool containsDirectory(const QString &path) const;
+  bool containsBuffer(const QString &name) const;
+  bool containsResource(const QString &path) const;
+  QByteArray buffer(const QString &name) const;
 
   QList<QStyleUpdater *> updaters() const;
   bool containsUpdater(QWidget *widget) const;
   QStyleUpdater *updater(QWidget *widget) const;
 
   bool autoReloadStyle() const;
+  QStringList paintOnlyProperties() const;
+
+  QStringList themes() const;
+  QString theme() const;
+  QList<Item> themeItems(const QString &theme) const;
+  bool backgroundThemeLoading() const;
+
+  ///
+  /// \brief Last applied style sheet
+  ///
+  QString styleSheet() const;
+  bool paletteBaking() const;
+  bool lazyPartitioning() const;
+
+  ///
+  /// \brief The loader accepts pushed styles on a local socket
+  ///
+  bool isListening() const;
+  QString serverName() const;
+
+  ///
+  /// \brief The loader takes part in a shared style cache
+  ///
+  bool isSharing() const;
+
+  ///
+  /// \brief This process loads, watches and publishes the styles of the shared cache
+  ///
+  bool isSharedOwner() const;
+
+  ///
+  /// \brief Polish profiling of the updaters is enabled
+  ///
+  bool polishProfiling() const;
+
+  QStringList profiles() const;
+  QStyleUpdater::Profile profile(const QString &name) const;
+
+  ///
+  /// \brief Polish costs of all updaters sorted from the most expensive
+  ///
+  QList<QStyleUpdater::PolishStat> polishStats(int top = -1) const;
+
+  ///
+  /// \brief Polish costs of the selectors sorted from the most expensive
+  ///
+  QList<RuleStat> ruleStats(int top = -1) const;
+  void clearPolishStats();
+
+  bool isBatchActive() const;
+  void beginBatch();
+  void endBatch();
 public slots:
-  void add(Item::Type type, const QString &path);
-  void addFile(const QString &path);
-  void addDirectory(const QString &path);
+  void add(Item::Type type, const QString &path, Item::Priority priority = Item::Priority::Critical);
+  void addFile(const QString &path, Item::Priority priority = Item::Priority::Critical);
+  void addDirectory(const QString &path, Item::Priority priority = Item::Priority::Critical);
+  void addResource(const QString &path, Item::Priority priority = Item::Priority::Critical);
+  void addBuffer(const QString &name, const QByteArray &data = QByteArray(), Item::Priority priority = Item::Priority::Critical);
+
+  ///
+  /// \brief Replaces the data of the buffer, a new buffer is added with the priority
+  ///
+  void setBuffer(const QString &name, const QByteArray &data, Item::Priority priority = Item::Priority::Critical);
   void remove(const QString &path);
 
   void removeUpdater(QWidget *widget);
   QStyleUpdater *addUpdater(QWidget *widget);
   QStyleUpdater *insertUpdater(QWidget *widget);
 
+  ///
+  /// \brief Adds an updater that shares the named profile
+  /// \details An existing updater of the widget is switched to the profile.
+  ///  With an unknown profile a warning is printed and the updater keeps its settings.
+  ///
+  QStyleUpdater *addUpdater(QWidget *widget, const QString &profile);
+
+  ///
+  /// \brief Registers or replaces the named updater profile
+  /// \details All updaters of the profile switch to the new settings at once,
+  ///  a profile without a repolish budget flushes their queued slices.
+  ///
+  void setProfile(const QString &name, const QStyleUpdater::Profile &profile);
+
+  ///
+  /// \brief Removes the profile, its updaters keep the last settings
+  /// \return False when there is no profile of the name
+  ///
+  bool removeProfile(const QString &name);
+
   void reloadAllStyle();
   void setAutoReloadStyle(bool enable);
 
+  ///
+  /// \brief Sets the glob patterns of the style files
+  /// \details An empty list includes all files. Excluded patterns are checked after
+  ///  the included ones, by default they skip backups and swap files of editors.
+  ///  Watched directories are rescanned once after the change.
+  ///
+  void setFileFilters(const QStringList &filters);
+  void setExcludeFilters(const QStringList &filters);
+  void setFileFilters(const QStringList &include, const QStringList &exclude);
+
+  ///
+  /// \brief Adds an item to the named theme set
+  /// \details The sheet of the current theme follows the common items. Inactive
+  ///  themes are watched and assembled in advance (in a thread pool when
+  ///  background loading is enabled), so switching applies a ready sheet.
+  ///
+  void addThemeItem(const QString &theme, Item::Type type, const QString &path);
+  void removeTheme(const QString &theme);
+  void setTheme(const QString &theme);
+  void setBackgroundThemeLoading(bool enable);
+
+  ///
+  /// \brief Applies simple color rules through application palettes
+  /// \details Rules of bare type selectors that only set text, selection and
+  ///  alternate background colors are moved into QApplication palettes when the
+  ///  palette gives the same result as the cascade. Background colors always stay
+  ///  in the style sheet. When no rule is left, the style sheet style is not used at all.
+  ///
+  void setPaletteBaking(bool enable);
+
+  ///
+  /// \brief Applies the rules of a widget class only once the class is used
+  /// \details Rules whose selectors all name a type without ancestors are applied
+  ///  when the first widget of that type or of a subclass is polished, before the
+  ///  widget itself is polished. A window activates the classes of all its children
+  ///  at once. Universal, typeless and ancestor-dependent rules are always applied.
+  ///
+  ///  Every activation re-applies the sheet, which repolishes all widgets of the
+  ///  application. After 16 activations all rules are applied from then on, also
+  ///  for later sheets, so partitioning costs at most 16 extra repolishes until it
+  ///  is enabled again. It trades startup cost for these repolishes, so it only pays
+  ///  off for large sheets of many rarely used classes: measure it with
+  ///  qstyle_bench partition before enabling it.
+  ///
+  void setLazyPartitioning(bool enable);
+
+  ///
+  /// \brief Starts accepting pushed styles on the local socket of the name
+  /// \details Pushed styles are applied about 50 ms after the last message,
+  ///  without the reload throttle and without reading files. Only processes
+  ///  of the same user can connect. Requires the library to be built with
+  ///  the Qt network module.
+  /// \return False when the server can not listen or another instance
+  ///  is listening on the name
+  ///
+  bool listen(const QString &name);
+  void stopListening();
+
+  ///
+  /// \brief Shares the assembled sheet with the other processes of the host
+  /// \details The first loader of the key owns a shared memory segment. It does the
+  ///  file I/O and the watching, and publishes every applied sheet together with a
+  ///  manifest of its sources. Loaders of other processes with the same manifest
+  ///  apply the published sheet and stop watching files. Loaders with different
+  ///  sources keep loading their own files. When the owner stops answering,
+  ///  another process takes over.
+  /// \param key Name of the segment, an empty key stops sharing
+  /// \param capacity Maximum size of the manifest and the sheet in bytes
+  /// \return False when the segment can not be created or attached
+  ///
+  bool setSharedCache(const QString &key, int capacity = 4 * 1024 * 1024);
+
+  ///
+  /// \brief Enables polish profiling of all updaters
+  /// \details The costs are collected per widget class and object name
+  ///  and attributed to the selectors of the applied sheet. Only repolishes
+  ///  done by the updaters are timed, not the polishes done by Qt itself.
+  ///
+  void setPolishProfiling(bool enable);
+
 signals:
   void styleReloaded(QStyleUpdater *updater, QWidget *widget);
   void fileStyleChanged(const QString &file);
+  void styleApplied();
+  void themeChanged(const QString &theme);
 };
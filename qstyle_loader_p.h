@@ -0,0 +1,216 @@
+#pragma once
+#include <QSet>
+#include <QHash>
+#include <QFile>
+#include <QPair>
+#include <QList>
+#include <QObject>
+#include <QPointer>
+#include <QString>
+#include <QVector>
+#include <QVariant>
+#include <QDataStream>
+#include <QStringList>
+#include <QElapsedTimer>
+#include <QRegularExpression>
+
+class QWidget;
+
+//
+//  W A R N I N G
+//  -------------
+//
+// This file is not part of the QStyleLoader API. It is used by the
+// implementation and the tools, and may change without notice.
+//
+
+///
+/// \brief Parts of one selector of a style sheet rule
+/// \details Only the subject (the last compound selector) is split into parts,
+///  the ancestors are only reported by hasAncestors.
+///
+struct QStyleSheetSelector
+{
+  QString                         type;         ///< Empty for "*" and for selectors without a type
+  bool                            exactType;    ///< ".QPushButton" does not match subclasses
+  QString                         id;
+  QList<QPair<QString, QString>>  attributes;   ///< Name and value, the value is empty for [name]
+  QStringList                     pseudoStates; ///< Negated states start with "!"
+  QString                         subControl;
+  bool                            hasAncestors;
+
+  QStyleSheetSelector();
+
+  ///
+  /// \brief The object matches the type, the id and the attributes of the subject
+  /// \details Pseudo-states, subcontrols and ancestors are not checked.
+  ///
+  bool matches(const QObject *object) const;
+
+  static QStyleSheetSelector parse(const QString &selector);
+};
+
+///
+/// \brief Rule of a Qt style sheet
+/// \details The parser only splits the text into selectors and declarations,
+///  it does not validate them. Comments and unsupported at-rules are skipped.
+///
+struct QStyleSheetRule
+{
+  QStringList                     selectors;
+  QList<QPair<QString, QString>>  declarations;
+
+  ///
+  /// \brief Rule text in the style sheet syntax
+  ///
+  QString text() const;
+
+  ///
+  /// \brief Names of the properties used by the attribute selectors
+  ///
+  QStringList attributes() const;
+
+  ///
+  /// \brief The rule only changes colors, borders or backgrounds
+  /// \details Applying such a rule does not change the size hint of a widget,
+  ///  so the widget does not need to be unpolished and laid out again.
+  ///
+  bool isPaintOnly() const;
+
+  static bool isPaintOnlyProperty(const QString &name);
+  static QStringList selectorAttributes(const QString &selector);
+  static QList<QStyleSheetRule> parse(const QString &styleSheet);
+};
+
+///
+/// \brief Compiled include and exclude file name patterns
+/// \details Patterns of the form "*suffix" are matched with a plain suffix check,
+///  all other patterns are compiled into one regular expression per list.
+///
+class QStyleLoaderFileFilter
+{
+  QStringList         m_include;
+  QStringList         m_exclude;
+  QStringList         m_includeSuffixes;
+  QStringList         m_excludeSuffixes;
+  QRegularExpression  m_includeExpression;
+  QRegularExpression  m_excludeExpression;
+public:
+  QStyleLoaderFileFilter(const QStringList &include = QStringList(),
+                         const QStringList &exclude = defaultExclude());
+
+public:
+  QStringList include() const;
+  QStringList exclude() const;
+
+  ///
+  /// \brief The file name is included and is not excluded
+  ///
+  bool match(const QString &fileName) const;
+
+  ///
+  /// \brief Matching files of the directory tree in the loading order
+  /// \details Files of a directory go before its subdirectories,
+  ///  directories reached again through symbolic links are skipped.
+  ///
+  QStringList files(const QString &directory) const;
+
+  ///
+  /// \brief Backups, swap files and merge leftovers of editors and tools
+  ///
+  static QStringList defaultExclude();
+
+private:
+  static void compile(const QStringList &patterns, QStringList &suffixes, QRegularExpression &expression);
+  static bool match(const QString &fileName, const QStringList &suffixes, const QRegularExpression &expression);
+  void files(const QString &directory, QSet<QString> &visited, QStringList &result) const;
+};
+
+///
+/// \brief Recorded change of a widget property
+/// \details The path names every widget from the top-level window down, as
+///  "class:objectName:index" segments separated by "/". The index counts the
+///  preceding siblings of the same class, class and object names are percent-encoded.
+///
+struct QStyleRecordEvent
+{
+  qint64      usecs;      ///< Time since the start of the recording
+  QString     path;
+  QByteArray  property;
+  QVariant    value;
+
+  QStyleRecordEvent();
+};
+
+///
+/// \brief Writes property changes into a compact recording
+/// \details The file is a QDataStream of tagged records. Widget paths and property
+///  names are written once into a string table and then referred to by their index,
+///  times are stored as deltas in microseconds. Values of types without stream
+///  operators are recorded as strings, or skipped when they have no string form.
+///
+class QStyleRecordWriter
+{
+  ///
+  /// \brief Path of a widget, valid while its ancestors and their object names
+  ///  stay the same and no children are added or removed
+  ///
+  struct PathEntry
+  {
+    QPointer<const QWidget>                   widget;
+    QVector<QPair<const QWidget*, QString>>   chain;  ///< The widget and its ancestors
+    quint32                                   id;
+  };
+
+  QFile                               m_file;
+  QDataStream                         m_stream;
+  QHash<QString, quint32>             m_strings;
+  QHash<const QWidget*, PathEntry>    m_paths;
+  QHash<int, bool>                    m_streamable;
+  QElapsedTimer                       m_timer;
+  qint64                              m_last;
+public:
+  QStyleRecordWriter();
+  ~QStyleRecordWriter();
+
+  bool open(const QString &fileName);
+  void close();
+  bool isOpen() const;
+  void write(const QWidget *widget, const QByteArray &property, const QVariant &value);
+
+  ///
+  /// \brief Drops the cached widget paths, sibling indexes change with added or removed children
+  ///
+  void invalidatePaths();
+
+  static QString widgetPath(const QWidget *widget);
+
+private:
+  quint32 string(const QString &text);
+  quint32 path(const QWidget *widget);
+  bool isStreamable(const QVariant &value);
+  Q_DISABLE_COPY(QStyleRecordWriter)
+};
+
+///
+/// \brief Reads a recording written by QStyleRecordWriter
+///
+class QStyleRecordReader
+{
+  QFile       m_file;
+  QDataStream m_stream;
+  QStringList m_strings;
+  qint64      m_usecs;
+public:
+  QStyleRecordReader();
+
+  bool open(const QString &fileName);
+
+  ///
+  /// \brief Reads the next event, returns false at the end or on a broken file
+  ///
+  bool read(QStyleRecordEvent &event);
+
+private:
+  Q_DISABLE_COPY(QStyleRecordReader)
+};
@@ -0,0 +1,136 @@
+#include "qstyle_loader.h"
+
+#include <QFile>
+#include <QtTest>
+#include <QLocalSocket>
+#include <QDataStream>
+#include <QSignalSpy>
+#include <QTemporaryDir>
+#include <QCoreApplication>
+
+/*
+ *
+ * Push channel of QStyleLoader, driven by a local client.
+ *
+ */
+
+class TstPush
+    : public QObject
+{
+  Q_OBJECT
+
+  QTemporaryDir m_dir;
+  QString       m_file;
+  QString       m_server;
+private slots:
+  void initTestCase()
+  {
+    QVERIFY( m_dir.isValid() );
+    m_file = m_dir.path() + "/button.qss";
+    QVERIFY( write( m_file, "QPushButton { color: red; }" ) );
+    m_server = QString( "tst_push_%1" ).arg( QCoreApplication::applicationPid() );
+  }
+
+  void pushItem()
+  {
+    QStyleLoader loader;
+    loader.addFile( m_file );
+    QVERIFY( loader.styleSheet().contains( "red" ) );
+    QVERIFY( loader.listen( m_server ) );
+    QVERIFY( loader.isListening() );
+
+    QSignalSpy applied ( &loader, &QStyleLoader::styleApplied );
+    QLocalSocket client;
+    client.connectToServer( m_server );
+    QVERIFY( client.waitForConnected( 1000 ) );
+    client.write( frame( 1, m_file, "QPushButton { color: blue; }" ) );
+    QVERIFY( client.waitForBytesWritten( 1000 ) );
+
+    QTRY_VERIFY( applied.count() > 0 );
+    QVERIFY( loader.styleSheet().contains( "blue" ) );
+    QVERIFY( !loader.styleSheet().contains( "red" ) );
+
+    // The file is read again when the pushed body is dropped
+    applied.clear();
+    QVERIFY( QStyleLoader::resetPushedStyle( m_server ) );
+    QTRY_VERIFY( applied.count() > 0 );
+    QVERIFY( loader.styleSheet().contains( "red" ) );
+    QVERIFY( !loader.styleSheet().contains( "blue" ) );
+  }
+
+  void pushSheet()
+  {
+    QStyleLoader loader;
+    loader.addFile( m_file );
+    QVERIFY( loader.listen( m_server ) );
+
+    QSignalSpy applied ( &loader, &QStyleLoader::styleApplied );
+    QVERIFY( QStyleLoader::pushStyle( m_server, QString(), "QLabel { color: green; }" ) );
+    QTRY_VERIFY( applied.count() > 0 );
+    QCOMPARE( loader.styleSheet(), QString( "QLabel { color: green; }" ) );
+
+    applied.clear();
+    QVERIFY( QStyleLoader::resetPushedStyle( m_server ) );
+    QTRY_VERIFY( applied.count() > 0 );
+    QVERIFY( loader.styleSheet().contains( "red" ) );
+  }
+
+  void runningInstanceIsKept()
+  {
+    QStyleLoader first;
+    QVERIFY( first.listen( m_server ) );
+
+    QStyleLoader second;
+    QVERIFY( !second.listen( m_server ) );
+    QVERIFY( first.isListening() );
+
+    QLocalSocket client;
+    client.connectToServer( m_server );
+    QVERIFY( client.waitForConnected( 1000 ) );
+  }
+
+  void brokenFrameIsIgnored()
+  {
+    QStyleLoader loader;
+    loader.addFile( m_file );
+    QVERIFY( loader.listen( m_server ) );
+
+    QSignalSpy applied ( &loader, &QStyleLoader::styleApplied );
+    QLocalSocket client;
+    client.connectToServer( m_server );
+    QVERIFY( client.waitForConnected( 1000 ) );
+    client.write( QByteArray( "\xff\xff\xff\xff", 4 ) );
+    QVERIFY( client.waitForBytesWritten( 1000 ) );
+    QTRY_COMPARE( client.state(), QLocalSocket::UnconnectedState );
+    QCOMPARE( applied.count(), 0 );
+  }
+
+private:
+  static bool write(const QString &path, const QByteArray &data)
+  {
+    QFile file ( path );
+    return file.open( QFile::WriteOnly | QFile::Truncate ) && file.write( data ) == data.size();
+  }
+
+  ///
+  /// \brief Frame of the push protocol: a length-prefixed payload of kind, item and body
+  ///
+  static QByteArray frame(quint8 kind, const QString &item, const QByteArray &data)
+  {
+    QByteArray payload;
+    {
+      QDataStream stream ( &payload, QIODevice::WriteOnly );
+      stream.setVersion( QDataStream::Qt_5_6 );
+      stream << kind << item << data;
+    }
+
+    QByteArray result;
+    QDataStream stream ( &result, QIODevice::WriteOnly );
+    stream.setVersion( QDataStream::Qt_5_6 );
+    stream << payload;
+    return result;
+  }
+};
+
+QTEST_MAIN(TstPush)
+#include "tst_push.moc"
@@ -0,0 +1,15 @@
+QT          += core widgets network testlib
+TARGET      = tst_push
+TEMPLATE    = app
+CONFIG      += console testcase c++11
+CONFIG      -= app_bundle
+
+INCLUDEPATH += ../..
+
+HEADERS += \
+    ../../qstyle_loader.h \
+    ../../qstyle_loader_p.h
+
+SOURCES += \
+    ../../qstyle_loader.cpp \
+    tst_push.cpp
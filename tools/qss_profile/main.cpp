@@ -0,0 +1,508 @@
+#include "qstyle_loader.h"
+#include "qstyle_loader_p.h"
+
+#include <algorithm>
+#include <functional>
+
+#include <QDir>
+#include <QFile>
+#include <QLabel>
+#include <QFrame>
+#include <QSlider>
+#include <QWidget>
+#include <QSpinBox>
+#include <QCheckBox>
+#include <QComboBox>
+#include <QGroupBox>
+#include <QLineEdit>
+#include <QTextEdit>
+#include <QFileInfo>
+#include <QScrollBar>
+#include <QTabWidget>
+#include <QTextStream>
+#include <QToolButton>
+#include <QListWidget>
+#include <QTreeWidget>
+#include <QVBoxLayout>
+#include <QPushButton>
+#include <QRadioButton>
+#include <QProgressBar>
+#include <QTableWidget>
+#include <QApplication>
+#include <QElapsedTimer>
+
+/*
+ *
+ * Headless profiler of Qt style sheets.
+ *
+ * Usage: qss_profile [options] <style files and directories>
+ *
+ */
+
+static QTextStream out( stdout );
+
+struct Options
+{
+  QStringList paths;
+  int         widgets;
+  int         top;
+  int         repeat;
+  bool        strict;
+
+  Options()
+    : widgets( 500 )
+    , top( 10 )
+    , repeat( 3 )
+    , strict( false )
+  {
+
+  }
+};
+
+struct StyleFile
+{
+  QString                 path;
+  QString                 text;
+  QList<QStyleSheetRule>  rules;
+  qint64                  parse;
+  qint64                  qtParse;
+  qint64                  leaveOneOut;
+};
+
+struct RuleCost
+{
+  const StyleFile  *file;
+  QStyleSheetRule   rule;
+  qint64            cost;
+};
+
+static void printUsage()
+{
+  out << "Usage: qss_profile [options] <style files and directories>\n"
+         "\n"
+         "Options:\n"
+         "  --widgets <n>  number of widgets in the generated tree (default 500)\n"
+         "  --top <n>      number of reported rules (default 10)\n"
+         "  --repeat <n>   measurements per sample, the fastest one is used (default 3)\n"
+         "  --strict       exit with code 2 when a rule can never match\n";
+  out.flush();
+}
+
+static bool parseOptions(const QStringList &args, Options &options)
+{
+  for ( int i = 1; i < args.size(); ++i ) {
+    auto arg = args.at( i );
+    if ( arg == "--widgets" && i + 1 < args.size() )
+      options.widgets = args.at( ++i ).toInt();
+    else if ( arg == "--top" && i + 1 < args.size() )
+      options.top = args.at( ++i ).toInt();
+    else if ( arg == "--repeat" && i + 1 < args.size() )
+      options.repeat = args.at( ++i ).toInt();
+    else if ( arg == "--strict" )
+      options.strict = true;
+    else if ( arg.startsWith( "--" ) )
+      return false;
+    else
+      options.paths << arg;
+  }
+
+  return !options.paths.isEmpty() && options.widgets > 0 && options.top >= 0 && options.repeat > 0;
+}
+
+static QString msecs(qint64 nsecs)
+{
+  return QString::number( nsecs / 1e6, 'f', 3 );
+}
+
+static QString quoted(QString text)
+{
+  return '"' + text.simplified().replace( '"', "\\\"" ) + '"';
+}
+
+/*
+ *
+ * Style files
+ *
+ */
+
+static QList<StyleFile> loadFiles(const QStringList &paths)
+{
+  // The same files in the same order as QStyleLoader loads them
+  QStringList files;
+  QStyleLoaderFileFilter filter;
+  for ( auto &path: paths ) {
+    if ( QFileInfo( path ).isDir() )
+      files << filter.files( path );
+    else
+      files << QFileInfo( path ).absoluteFilePath();
+  }
+
+  QList<StyleFile> result;
+  for ( auto &path: files ) {
+    QFile file ( path );
+    if ( !file.open( QFile::ReadOnly ) ) {
+      out << QString( "error file=%1 reason=%2\n" ).arg( path, quoted( file.errorString() ) );
+      continue;
+    }
+
+    StyleFile style;
+    style.path = path;
+    style.text = QString::fromUtf8( file.readAll() );
+    style.parse = 0;
+    style.qtParse = 0;
+    style.leaveOneOut = 0;
+    result << style;
+  }
+
+  return result;
+}
+
+static QString joinFiles(const QList<StyleFile> &files, int skip = -1)
+{
+  QStringList result;
+  for ( int i = 0; i < files.size(); ++i )
+    if ( i != skip )
+      result << files.at( i ).text;
+  return result.join( '\n' );
+}
+
+/*
+ *
+ * Measurements
+ *
+ */
+
+///
+/// \brief Fastest of the repeated samples
+///
+static qint64 measure(int repeat, const std::function<void()> &prepare, const std::function<void()> &sample)
+{
+  qint64 result = -1;
+  QElapsedTimer timer;
+  for ( int i = 0; i < repeat; ++i ) {
+    prepare();
+    timer.start();
+    sample();
+    auto elapsed = timer.nsecsElapsed();
+    if ( result < 0 || elapsed < result )
+      result = elapsed;
+  }
+  return result;
+}
+
+///
+/// \brief Time of QApplication::setStyleSheet, which parses the sheet and repolishes every widget
+///
+static qint64 applyCost(const QString &styleSheet, int repeat)
+{
+  return measure( repeat,
+                  [] {
+                    qApp->setStyleSheet( QString() );
+                    qApp->processEvents();
+                  },
+                  [&styleSheet] { qApp->setStyleSheet( styleSheet ); } );
+}
+
+/*
+ *
+ * Widget tree
+ *
+ */
+
+static QWidget *createWidget(int kind, QWidget *parent)
+{
+  switch ( kind % 18 ) {
+    case 0:  return new QLabel( "Label", parent );
+    case 1:  return new QPushButton( "Button", parent );
+    case 2:  return new QToolButton( parent );
+    case 3:  return new QCheckBox( "Check", parent );
+    case 4:  return new QRadioButton( "Radio", parent );
+    case 5:  return new QLineEdit( "Edit", parent );
+    case 6:  return new QTextEdit( "Text", parent );
+    case 7: {
+      auto combo = new QComboBox( parent );
+      combo->addItems( { "One", "Two" } );
+      return combo;
+    }
+    case 8:  return new QSpinBox( parent );
+    case 9:  return new QSlider( Qt::Horizontal, parent );
+    case 10: return new QProgressBar( parent );
+    case 11: return new QScrollBar( Qt::Vertical, parent );
+    case 12: {
+      auto list = new QListWidget( parent );
+      list->addItems( { "One", "Two", "Three" } );
+      return list;
+    }
+    case 13: {
+      auto tree = new QTreeWidget( parent );
+      new QTreeWidgetItem( tree, QStringList( "Item" ) );
+      return tree;
+    }
+    case 14: return new QTableWidget( 3, 3, parent );
+    case 15: {
+      auto tabs = new QTabWidget( parent );
+      tabs->addTab( new QWidget, "First" );
+      tabs->addTab( new QWidget, "Second" );
+      return tabs;
+    }
+    case 16: {
+      auto frame = new QFrame( parent );
+      frame->setFrameShape( QFrame::StyledPanel );
+      return frame;
+    }
+    default: return new QWidget( parent );
+  }
+}
+
+///
+/// \brief Groups of common widgets, named and tagged after the selectors of the sheet
+/// \details Every object name and attribute value used by a selector is given to
+///  some widgets of the tree, so that such rules have something to match.
+///
+static QWidget *createTree(int count, const QList<StyleFile> &files)
+{
+  QStringList names;
+  QList<QPair<QString, QString>> attributes;
+  for ( auto &file: files ) {
+    for ( auto &rule: file.rules ) {
+      for ( auto &selector: rule.selectors ) {
+        auto parsed = QStyleSheetSelector::parse( selector );
+        if ( !parsed.id.isEmpty() && !names.contains( parsed.id ) )
+          names << parsed.id;
+        for ( auto &attribute: parsed.attributes )
+          if ( !attributes.contains( attribute ) )
+            attributes << attribute;
+      }
+    }
+  }
+
+  auto window = new QWidget;
+  auto windowLayout = new QVBoxLayout( window );
+  QGroupBox *group = nullptr;
+
+  for ( int i = 0; i < count; ++i ) {
+    if ( i % 8 == 0 ) {
+      group = new QGroupBox( QString( "Group %1" ).arg( i / 8 ), window );
+      new QVBoxLayout( group );
+      windowLayout->addWidget( group );
+    }
+
+    auto w = createWidget( i, group );
+    group->layout()->addWidget( w );
+
+    if ( !names.isEmpty() && i < names.size() * 2 )
+      w->setObjectName( names.at( i % names.size() ) );
+    if ( !attributes.isEmpty() && i % 4 == 0 ) {
+      auto &attribute = attributes.at( ( i / 4 ) % attributes.size() );
+      w->setProperty( attribute.first.toUtf8().constData(),
+                      attribute.second.isEmpty() ? QVariant( true ) : QVariant( attribute.second ) );
+    }
+  }
+
+  return window;
+}
+
+/*
+ *
+ * Static checks
+ *
+ */
+
+static const QSet<QString> &knownPseudoStates()
+{
+  static const QSet<QString> states {
+    "active", "adjoins-item", "alternate", "bottom", "checked", "closable", "closed",
+    "default", "disabled", "editable", "edit-focus", "enabled", "exclusive", "first",
+    "flat", "floatable", "focus", "has-children", "has-siblings", "horizontal", "hover",
+    "indeterminate", "last", "left", "maximized", "middle", "minimized", "movable",
+    "no-frame", "non-exclusive", "off", "on", "only-one", "open", "next-selected",
+    "pressed", "previous-selected", "read-only", "right", "selected", "top", "unchecked",
+    "vertical", "window"
+  };
+  return states;
+}
+
+static const QSet<QString> &knownSubControls()
+{
+  static const QSet<QString> subControls {
+    "add-line", "add-page", "branch", "chunk", "close-button", "corner", "down-arrow",
+    "down-button", "drop-down", "float-button", "groove", "indicator", "handle", "icon",
+    "item", "left-arrow", "left-corner", "menu-arrow", "menu-button", "menu-indicator",
+    "right-arrow", "pane", "right-corner", "scroller", "section", "separator", "sub-line",
+    "sub-page", "tab", "tab-bar", "tear", "tearoff", "text", "title", "up-arrow", "up-button"
+  };
+  return subControls;
+}
+
+///
+/// \brief Reasons why the selector can never match a widget, empty when it may match
+///
+static QStringList neverMatches(const QString &selector)
+{
+  static const QList<QPair<QString, QString>> opposites {
+    { "checked", "unchecked" },
+    { "enabled", "disabled" },
+    { "on", "off" },
+    { "horizontal", "vertical" },
+    { "open", "closed" },
+    { "exclusive", "non-exclusive" }
+  };
+
+  QStringList result;
+  auto parsed = QStyleSheetSelector::parse( selector );
+
+  QSet<QString> states;
+  for ( auto &state: parsed.pseudoStates ) {
+    auto name = state.startsWith( '!' ) ? state.mid( 1 ) : state;
+    if ( !knownPseudoStates().contains( name.toLower() ) )
+      result << QString( "unknown pseudo-state :%1" ).arg( name );
+    states.insert( state.toLower() );
+  }
+
+  for ( auto &state: states )
+    if ( !state.startsWith( '!' ) && states.contains( "!" + state ) )
+      result << QString( "contradictory :%1 and :!%1" ).arg( state );
+
+  for ( auto &pair: opposites )
+    if ( states.contains( pair.first ) && states.contains( pair.second ) )
+      result << QString( "contradictory :%1 and :%2" ).arg( pair.first, pair.second );
+
+  if ( !parsed.subControl.isEmpty() && !knownSubControls().contains( parsed.subControl.toLower() ) )
+    result << QString( "unknown subcontrol ::%1" ).arg( parsed.subControl );
+
+  return result;
+}
+
+/*
+ *
+ * Report
+ *
+ */
+
+static int profile(const Options &options)
+{
+  // The loader assembles the sheet exactly as an application would see it
+  QStyleLoader loader;
+  loader.setAutoReloadStyle( false );
+  for ( auto &path: options.paths ) {
+    if ( QFileInfo( path ).isDir() )
+      loader.addDirectory( path );
+    else
+      loader.addFile( path );
+  }
+  loader.reloadAllStyle();
+  auto styleSheet = loader.styleSheet();
+  qApp->setStyleSheet( QString() );
+
+  auto files = loadFiles( options.paths );
+  if ( files.isEmpty() ) {
+    out << "error reason=\"no style files\"\n";
+    return 1;
+  }
+
+  // Parse cost of the own parser and of Qt, on one widget
+  {
+    QWidget probe;
+    probe.ensurePolished();
+    for ( auto &file: files ) {
+      QElapsedTimer timer;
+      timer.start();
+      file.rules = QStyleSheetRule::parse( file.text );
+      file.parse = timer.nsecsElapsed();
+      file.qtParse = applyCost( file.text, options.repeat );
+    }
+  }
+
+  // Cost on a representative widget tree
+  int widgets = options.widgets;
+  QScopedPointer<QWidget> window ( createTree( widgets, files ) );
+  window->show();
+  qApp->processEvents();
+  widgets = window->findChildren<QWidget *>().size() + 1;
+
+  auto baseline = applyCost( "#qss_profile_nothing { color: red; }", options.repeat );
+  auto total = applyCost( styleSheet, options.repeat );
+
+  int ruleCount = 0;
+  for ( auto &file: files )
+    ruleCount += file.rules.size();
+
+  out << QString( "total files=%1 rules=%2 widgets=%3 setstylesheet_ms=%4 baseline_ms=%5\n" )
+         .arg( files.size() )
+         .arg( ruleCount )
+         .arg( widgets )
+         .arg( msecs( total ) )
+         .arg( msecs( baseline ) );
+
+  // Files by leave-one-out cost
+  if ( files.size() > 1 )
+    for ( int i = 0; i < files.size(); ++i )
+      files[ i ].leaveOneOut = total - applyCost( joinFiles( files, i ), options.repeat );
+
+  for ( auto &file: files )
+    out << QString( "file path=%1 bytes=%2 rules=%3 parse_ms=%4 qt_parse_ms=%5 leave_one_out_ms=%6\n" )
+           .arg( quoted( file.path ) )
+           .arg( file.text.toUtf8().size() )
+           .arg( file.rules.size() )
+           .arg( msecs( file.parse ) )
+           .arg( msecs( file.qtParse ) )
+           .arg( files.size() > 1 ? msecs( file.leaveOneOut ) : QString( "-" ) );
+
+  // Rules by isolated cost
+  QList<RuleCost> costs;
+  if ( options.top > 0 ) {
+    for ( auto &file: files )
+      for ( auto &rule: file.rules )
+        costs << RuleCost { &file, rule, applyCost( rule.text(), options.repeat ) - baseline };
+
+    std::stable_sort( costs.begin(), costs.end(), [](const RuleCost &a, const RuleCost &b) { return a.cost > b.cost; } );
+    costs = costs.mid( 0, options.top );
+  }
+
+  int rank = 0;
+  for ( auto &cost: costs )
+    out << QString( "rule rank=%1 cost_ms=%2 file=%3 selector=%4\n" )
+           .arg( ++rank )
+           .arg( msecs( cost.cost ) )
+           .arg( quoted( cost.file->path ) )
+           .arg( quoted( cost.rule.selectors.join( ", " ) ) );
+
+  // Rules that can never match or have no effect
+  int issues = 0;
+  for ( auto &file: files ) {
+    for ( auto &rule: file.rules ) {
+      if ( rule.declarations.isEmpty() ) {
+        out << QString( "never file=%1 selector=%2 reason=%3\n" )
+               .arg( quoted( file.path ), quoted( rule.selectors.join( ", " ) ), quoted( "empty declaration block" ) );
+        ++issues;
+      }
+
+      for ( auto &selector: rule.selectors ) {
+        for ( auto &reason: neverMatches( selector ) ) {
+          out << QString( "never file=%1 selector=%2 reason=%3\n" )
+                 .arg( quoted( file.path ), quoted( selector ), quoted( reason ) );
+          ++issues;
+        }
+      }
+    }
+  }
+
+  out.flush();
+  return options.strict && issues > 0 ? 2 : 0;
+}
+
+int main(int argc, char *argv[])
+{
+  if ( qEnvironmentVariableIsEmpty( "QT_QPA_PLATFORM" ) )
+    qputenv( "QT_QPA_PLATFORM", "offscreen" );
+
+  QApplication app( argc, argv );
+
+  Options options;
+  if ( !parseOptions( app.arguments(), options ) ) {
+    printUsage();
+    return 1;
+  }
+
+  return profile( options );
+}
@@ -0,0 +1,15 @@
+QT          += core widgets
+TARGET      = qss_profile
+TEMPLATE    = app
+CONFIG      += console c++11
+CONFIG      -= app_bundle
+
+INCLUDEPATH += ../..
+
+HEADERS += \
+    ../../qstyle_loader.h \
+    ../../qstyle_loader_p.h
+
+SOURCES += \
+    ../../qstyle_loader.cpp \
+    main.cpp
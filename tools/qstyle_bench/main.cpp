@@ -0,0 +1,643 @@
+#include "qstyle_loader.h"
+#include "qstyle_loader_p.h"
+
+#include <cmath>
+#include <ctime>
+#include <cstdio>
+#include <algorithm>
+#include <functional>
+
+#include <QDir>
+#include <QFile>
+#include <QLabel>
+#include <QStyle>
+#include <QSlider>
+#include <QSpinBox>
+#include <QCheckBox>
+#include <QComboBox>
+#include <QGroupBox>
+#include <QTextEdit>
+#include <QTabWidget>
+#include <QToolButton>
+#include <QRadioButton>
+#include <QProgressBar>
+#include <QThread>
+#include <QWidget>
+#include <QSet>
+#include <QEvent>
+#include <QTimer>
+#include <QPixmap>
+#include <QLineEdit>
+#include <QEventLoop>
+#include <QFileInfo>
+#include <QTextStream>
+#include <QGridLayout>
+#include <QTemporaryDir>
+#include <QPushButton>
+#include <QApplication>
+#include <QElapsedTimer>
+
+/*
+ *
+ * Headless benchmarks of QStyleLoader.
+ *
+ * Usage: qstyle_bench <mode> [options] [style files and directories]
+ *
+ */
+
+static QTextStream out( stdout );
+
+static const char *defaultStyle =
+    "* { color: #e0e0e0; }\n"
+    "* { background-color: #202020; }\n"
+    "QPushButton { background-color: #303040; }\n"
+    "QLabel { color: #c0c0ff; }\n"
+    "QLineEdit { background-color: #101010; }\n"
+    "QLineEdit { selection-background-color: #4060a0; }\n";
+
+struct Options
+{
+  QString     mode;
+  QStringList paths;
+  int         widgets;
+  int         frames;
+  int         files;
+  int         rounds;
+  int         idle;
+
+  Options()
+    : widgets( 2000 )
+    , frames( 50 )
+    , files( 2000 )
+    , rounds( 3 )
+    , idle( 5 )
+  {
+
+  }
+};
+
+static void printUsage()
+{
+  out << "Usage: qstyle_bench <mode> [options] [style files and directories]\n"
+         "\n"
+         "Modes:\n"
+         "  paint          paint throughput of a widget grid with and without palette baking\n"
+         "  traversal      cost of the updater index: setWidget, reloadStyle, adding and removing children\n"
+         "  watcher        idle cost of the file watchers and latency of edits, renames, deletes and bursts\n"
+         "  partition      startup, per-polish and first-use cost with and without lazy partitioning\n"
+         "\n"
+         "Options:\n"
+         "  --widgets <n>  number of widgets (default 2000)\n"
+         "  --frames <n>   number of painted frames or reload repetitions (default 50)\n"
+         "  --files <n>    number of style files in the watched tree (default 2000)\n"
+         "  --rounds <n>   repetitions of every watcher scenario (default 3)\n"
+         "  --idle <s>     seconds of idle measurement (default 5)\n";
+  out.flush();
+}
+
+static bool parseOptions(const QStringList &args, Options &options)
+{
+  if ( args.size() < 2 )
+    return false;
+
+  options.mode = args.at( 1 );
+  for ( int i = 2; i < args.size(); ++i ) {
+    auto arg = args.at( i );
+    if ( arg == "--widgets" && i + 1 < args.size() )
+      options.widgets = args.at( ++i ).toInt();
+    else if ( arg == "--frames" && i + 1 < args.size() )
+      options.frames = args.at( ++i ).toInt();
+    else if ( arg == "--files" && i + 1 < args.size() )
+      options.files = args.at( ++i ).toInt();
+    else if ( arg == "--rounds" && i + 1 < args.size() )
+      options.rounds = args.at( ++i ).toInt();
+    else if ( arg == "--idle" && i + 1 < args.size() )
+      options.idle = args.at( ++i ).toInt();
+    else if ( arg.startsWith( "--" ) )
+      return false;
+    else
+      options.paths << arg;
+  }
+
+  return options.widgets > 0 && options.frames > 0
+      && options.files > 0 && options.rounds > 0 && options.idle >= 0;
+}
+
+static void addStyles(QStyleLoader &loader, const QStringList &paths)
+{
+  for ( auto &path: paths ) {
+    if ( QFileInfo( path ).isDir() )
+      loader.addDirectory( path );
+    else
+      loader.addFile( path );
+  }
+
+  if ( paths.isEmpty() )
+    loader.addBuffer( "default", defaultStyle );
+
+  loader.reloadAllStyle();
+}
+
+static QWidget *createGrid(int count)
+{
+  auto window = new QWidget;
+  auto layout = new QGridLayout( window );
+  auto columns = qMax( 1, int( std::sqrt( double( count ) ) ) );
+
+  for ( int i = 0; i < count; ++i ) {
+    QWidget *w = nullptr;
+    switch ( i % 3 ) {
+      case 0:  w = new QLabel( QString( "Cell %1" ).arg( i ) ); break;
+      case 1:  w = new QPushButton( QString( "Button %1" ).arg( i ) ); break;
+      default: w = new QLineEdit( QString( "Edit %1" ).arg( i ) ); break;
+    }
+    layout->addWidget( w, i / columns, i % columns );
+  }
+
+  return window;
+}
+
+static double framesPerSecond(QWidget *window, int frames)
+{
+  // The first frame polishes and lays out the widgets
+  window->grab();
+
+  QElapsedTimer timer;
+  timer.start();
+  for ( int i = 0; i < frames; ++i )
+    window->grab();
+
+  return frames * 1e9 / qMax<qint64>( 1, timer.nsecsElapsed() );
+}
+
+static int benchPaint(const Options &options)
+{
+  QStyleLoader loader;
+  addStyles( loader, options.paths );
+
+  QScopedPointer<QWidget> window ( createGrid( options.widgets ) );
+  window->show();
+
+  for ( auto baking: { false, true } ) {
+    loader.setPaletteBaking( baking );
+    qApp->processEvents();
+
+    auto fps = framesPerSecond( window.data(), options.frames );
+    out << QString( "paint baking=%1 widgets=%2 frames=%3 fps=%4 stylesheet=%5\n" )
+           .arg( baking ? "on" : "off" )
+           .arg( options.widgets )
+           .arg( options.frames )
+           .arg( fps, 0, 'f', 2 )
+           .arg( qApp->styleSheet().isEmpty() ? "none" : "used" );
+    out.flush();
+  }
+
+  return 0;
+}
+
+static QWidget *createTree(QWidget *parent, int &count, int depth)
+{
+  // Every level has up to 8 children, until the widgets run out
+  for ( int i = 0; i < 8 && count > 0; ++i ) {
+    auto w = new QWidget( parent );
+    --count;
+    if ( depth > 0 )
+      createTree( w, count, depth - 1 );
+  }
+
+  return parent;
+}
+
+static QString msecs(qint64 nsecs)
+{
+  return QString::number( nsecs / 1e6, 'f', 3 );
+}
+
+static int benchTraversal(const Options &options)
+{
+  QStyleLoader loader;
+  addStyles( loader, options.paths );
+
+  QWidget root;
+  auto count = options.widgets;
+  while ( count > 0 )
+    createTree( &root, count, 4 );
+
+  QElapsedTimer timer;
+  QStyleUpdater updater( true, true );
+
+  timer.start();
+  updater.setWidget( &root );
+  auto index = timer.nsecsElapsed();
+
+  timer.restart();
+  for ( int i = 0; i < options.frames; ++i )
+    updater.reloadStyle();
+  auto reload = timer.nsecsElapsed() / options.frames;
+
+  timer.restart();
+  auto container = new QWidget;
+  auto added = options.widgets;
+  createTree( container, added, 4 );
+  container->setParent( &root );
+  auto add = timer.nsecsElapsed();
+
+  timer.restart();
+  delete container;
+  auto remove = timer.nsecsElapsed();
+
+  out << QString( "traversal widgets=%1 index_ms=%2 reload_ms=%3 add_subtree_ms=%4 remove_subtree_ms=%5\n" )
+         .arg( options.widgets )
+         .arg( msecs( index ) )
+         .arg( msecs( reload ) )
+         .arg( msecs( add ) )
+         .arg( msecs( remove ) );
+  out.flush();
+
+  return 0;
+}
+
+///
+/// \brief Counts the timer events of the whole application
+///
+class WakeupCounter final
+    : public QObject
+{
+public:
+  int count;
+
+  WakeupCounter()
+    : count( 0 )
+  {
+    qApp->installEventFilter( this );
+  }
+  ~WakeupCounter() override
+  {
+    qApp->removeEventFilter( this );
+  }
+
+protected:
+  bool eventFilter(QObject *watched, QEvent *event) override
+  {
+    if ( event->type() == QEvent::Timer )
+      ++count;
+    return QObject::eventFilter( watched, event );
+  }
+};
+
+///
+/// \brief Signals of the loader with the time they arrived
+///
+struct WatcherProbe
+{
+  QElapsedTimer clock;
+  QStringList   changed;
+  qint64        lastChanged;
+  qint64        lastApplied;
+  int           applied;
+
+  WatcherProbe()
+    : lastChanged( -1 )
+    , lastApplied( -1 )
+    , applied( 0 )
+  {
+    clock.start();
+  }
+
+  void reset()
+  {
+    changed.clear();
+    lastChanged = -1;
+    lastApplied = -1;
+    applied = 0;
+  }
+};
+
+static void writeStyle(const QString &path, int index, int revision)
+{
+  QFile file ( path );
+  if ( file.open( QFile::WriteOnly | QFile::Truncate ) )
+    file.write( QString( "#w%1 { color: #%2; }\n" )
+                .arg( index )
+                .arg( ( index * 7919 + revision * 104729 ) & 0xffffff, 6, 16, QChar( '0' ) )
+                .toUtf8() );
+}
+
+///
+/// \brief Files spread over two levels of up to 16 directories
+///
+static QStringList createThemeTree(const QString &root, int count)
+{
+  QStringList files;
+  for ( int i = 0; i < count; ++i ) {
+    auto dir = QString( "%1/d%2/d%3" ).arg( root ).arg( i % 16 ).arg( ( i / 16 ) % 16 );
+    QDir().mkpath( dir );
+    auto path = QString( "%1/style%2.qss" ).arg( dir ).arg( i );
+    writeStyle( path, i, 0 );
+    files << path;
+  }
+  return files;
+}
+
+///
+/// \brief Runs the event loop until the condition holds or the timeout expires
+///
+static bool waitFor(const std::function<bool()> &condition, int timeout)
+{
+  QElapsedTimer timer;
+  timer.start();
+  while ( !condition() ) {
+    if ( timer.elapsed() > timeout )
+      return false;
+    qApp->processEvents();
+    QThread::msleep( 1 );
+  }
+  return true;
+}
+
+///
+/// \brief Runs the event loop without polling, so only the loader wakes it up
+///
+static void idleFor(int timeout)
+{
+  QEventLoop loop;
+  QTimer::singleShot( timeout, &loop, &QEventLoop::quit );
+  loop.exec();
+}
+
+///
+/// \brief Time from the change to the last detection and to the last applied sheet
+///
+static void runScenario(const QString &name, int rounds, WatcherProbe &probe, const std::function<int(int)> &churn)
+{
+  QVector<qint64> detected, applied;
+  int reloads = 0, redundant = 0, missed = 0;
+
+  for ( int round = 0; round < rounds; ++round ) {
+    probe.reset();
+    auto start = probe.clock.nsecsElapsed();
+    auto expected = churn( round );
+
+    // The sheet is applied after the last detected change, later applies are redundant
+    auto ok = waitFor( [&]() { return probe.changed.size() >= expected && probe.lastApplied > probe.lastChanged; }, 15000 );
+    idleFor( 2500 );
+
+    if ( !ok ) {
+      ++missed;
+      continue;
+    }
+    detected << probe.lastChanged - start;
+    applied << probe.lastApplied - start;
+    reloads += probe.applied;
+    redundant += qMax( 0, probe.applied - 1 );
+  }
+
+  std::sort( detected.begin(), detected.end() );
+  std::sort( applied.begin(), applied.end() );
+  auto median = [](const QVector<qint64> &v) { return v.isEmpty() ? 0 : v.at( v.size() / 2 ); };
+  auto maximum = [](const QVector<qint64> &v) { return v.isEmpty() ? 0 : v.last(); };
+
+  out << QString( "churn scenario=%1 rounds=%2 detect_p50_ms=%3 detect_max_ms=%4 applied_p50_ms=%5 applied_max_ms=%6 reloads=%7 redundant=%8 missed=%9\n" )
+         .arg( name )
+         .arg( rounds )
+         .arg( msecs( median( detected ) ) )
+         .arg( msecs( maximum( detected ) ) )
+         .arg( msecs( median( applied ) ) )
+         .arg( msecs( maximum( applied ) ) )
+         .arg( reloads )
+         .arg( redundant )
+         .arg( missed );
+  out.flush();
+}
+
+///
+/// The scenarios only use the public API of QStyleLoader, so any watcher
+/// backend built into the library runs against the same workload.
+///
+static int benchWatcher(const Options &options)
+{
+  QTemporaryDir root;
+  if ( !root.isValid() ) {
+    out << "error reason=\"can not create a temporary directory\"\n";
+    return 1;
+  }
+
+  auto files = createThemeTree( root.path() + "/theme", options.files );
+  auto single = root.path() + "/single.qss";
+  writeStyle( single, -1, 0 );
+
+  QElapsedTimer timer;
+  timer.start();
+  QStyleLoader loader;
+  loader.addDirectory( root.path() + "/theme" );
+  loader.addFile( single );
+  loader.reloadAllStyle();
+  auto setup = timer.nsecsElapsed();
+
+  WatcherProbe probe;
+  QObject::connect( &loader, &QStyleLoader::fileStyleChanged, [&probe](const QString &path) {
+    probe.changed << path;
+    probe.lastChanged = probe.clock.nsecsElapsed();
+  });
+  QObject::connect( &loader, &QStyleLoader::styleApplied, [&probe]() {
+    ++probe.applied;
+    probe.lastApplied = probe.clock.nsecsElapsed();
+  });
+
+  out << QString( "watcher files=%1 setup_ms=%2\n" ).arg( options.files ).arg( msecs( setup ) );
+
+  // Idle cost
+  {
+    WakeupCounter wakeups;
+    probe.reset();
+    auto cpu = std::clock();
+    idleFor( options.idle * 1000 );
+    cpu = std::clock() - cpu;
+
+    out << QString( "idle seconds=%1 cpu_ms=%2 timer_wakeups=%3 reloads=%4\n" )
+           .arg( options.idle )
+           .arg( cpu * 1000.0 / CLOCKS_PER_SEC, 0, 'f', 1 )
+           .arg( wakeups.count )
+           .arg( probe.applied );
+    out.flush();
+  }
+
+  int revision = 0;
+
+  runScenario( "file_edit", options.rounds, probe, [&](int) {
+    writeStyle( single, -1, ++revision );
+    return 1;
+  });
+
+  runScenario( "edit", options.rounds, probe, [&](int round) {
+    auto index = ( round * 37 ) % files.size();
+    writeStyle( files.at( index ), index, ++revision );
+    return 1;
+  });
+
+  runScenario( "atomic_rename", options.rounds, probe, [&](int round) {
+    // Editors write a temporary file and rename it over the original
+    auto index = ( round * 53 + 1 ) % files.size();
+    auto temporary = files.at( index ) + ".tmp";
+    writeStyle( temporary, index, ++revision );
+    std::rename( QFile::encodeName( temporary ).constData(), QFile::encodeName( files.at( index ) ).constData() );
+    return 1;
+  });
+
+  runScenario( "delete", options.rounds, probe, [&](int) {
+    if ( files.size() > 1 )
+      QFile::remove( files.takeLast() );
+    return 1;
+  });
+
+  runScenario( "burst", options.rounds, probe, [&](int round) {
+    QSet<int> written;
+    auto count = qMin( 50, files.size() );
+    for ( int i = 0; i < count; ++i ) {
+      auto index = ( round * 101 + i * 13 ) % files.size();
+      writeStyle( files.at( index ), index, ++revision );
+      written.insert( index );
+    }
+    return written.size();
+  });
+
+  return 0;
+}
+
+/*
+ *
+ * Partition
+ *
+ */
+
+static QWidget *createWidget(int kind, QWidget *parent)
+{
+  switch ( kind ) {
+    case 0:  return new QLabel( parent );
+    case 1:  return new QPushButton( parent );
+    case 2:  return new QLineEdit( parent );
+    case 3:  return new QCheckBox( parent );
+    case 4:  return new QRadioButton( parent );
+    case 5:  return new QToolButton( parent );
+    case 6:  return new QComboBox( parent );
+    case 7:  return new QSpinBox( parent );
+    case 8:  return new QSlider( parent );
+    case 9:  return new QProgressBar( parent );
+    case 10: return new QTextEdit( parent );
+    case 11: return new QGroupBox( parent );
+    default: return new QTabWidget( parent );
+  }
+}
+
+static const int WidgetKinds = 13;
+
+///
+/// \brief Rules for every widget kind, most of them unused by the startup window
+///
+static QString partitionStyle()
+{
+  static const char *classes[] = {
+    "QLabel", "QPushButton", "QLineEdit", "QCheckBox", "QRadioButton", "QToolButton", "QComboBox",
+    "QSpinBox", "QSlider", "QProgressBar", "QTextEdit", "QGroupBox", "QTabWidget"
+  };
+
+  QStringList rules;
+  rules << "* { font-size: 12px; }";
+  for ( auto name: classes ) {
+    for ( int i = 0; i < 20; ++i ) {
+      auto color = ( qHash( QString( name ) ) + i * 7919 ) & 0xffffff;
+      rules << QString( "%1#item%2 { color: #%3; }" ).arg( name ).arg( i ).arg( color, 6, 16, QChar( '0' ) );
+      rules << QString( "%1[level=\"%2\"]:hover { background-color: #%3; }" ).arg( name ).arg( i ).arg( color ^ 0xffffff, 6, 16, QChar( '0' ) );
+    }
+    rules << QString( "%1 { border: 1px solid #404040; padding: 2px; }" ).arg( name );
+  }
+  return rules.join( '\n' );
+}
+
+static int benchPartition(const Options &options)
+{
+  for ( auto lazy: { false, true } ) {
+    qApp->setStyleSheet( QString() );
+    qApp->processEvents();
+
+    QElapsedTimer timer;
+    timer.start();
+    QStyleLoader loader;
+    loader.setLazyPartitioning( lazy );
+    if ( options.paths.isEmpty() ) {
+      loader.addBuffer( "partition", partitionStyle().toUtf8() );
+      loader.reloadAllStyle();
+    } else {
+      addStyles( loader, options.paths );
+    }
+
+    // The startup window only uses the first three kinds
+    QScopedPointer<QWidget> window ( createGrid( options.widgets ) );
+    window->show();
+    qApp->processEvents();
+    auto startup = timer.nsecsElapsed();
+    auto active = QStyleSheetRule::parse( qApp->styleSheet() ).size();
+
+    // Polish cost of the widgets of the running window
+    auto widgets = window->findChildren<QWidget*>();
+    timer.restart();
+    for ( int i = 0; i < options.frames; ++i ) {
+      for ( auto w: widgets ) {
+        w->style()->unpolish( w );
+        w->style()->polish( w );
+      }
+    }
+    auto polish = timer.nsecsElapsed() / qMax( 1, options.frames * widgets.size() );
+
+    // A window with a kind that was not used yet
+    QVector<qint64> firstUse;
+    for ( int kind = 3; kind < WidgetKinds; ++kind ) {
+      timer.restart();
+      QScopedPointer<QWidget> dialog ( new QWidget );
+      createWidget( kind, dialog.data() );
+      dialog->show();
+      qApp->processEvents();
+      firstUse << timer.nsecsElapsed();
+    }
+    std::sort( firstUse.begin(), firstUse.end() );
+
+    out << QString( "partition lazy=%1 widgets=%2 rules=%3 active_rules=%4 startup_ms=%5 polish_us=%6 first_use_p50_ms=%7 first_use_max_ms=%8\n" )
+           .arg( lazy ? "on" : "off" )
+           .arg( options.widgets )
+           .arg( QStyleSheetRule::parse( loader.styleSheet() ).size() )
+           .arg( active )
+           .arg( msecs( startup ) )
+           .arg( polish / 1e3, 0, 'f', 2 )
+           .arg( msecs( firstUse.at( firstUse.size() / 2 ) ) )
+           .arg( msecs( firstUse.last() ) );
+    out.flush();
+  }
+
+  return 0;
+}
+
+int main(int argc, char *argv[])
+{
+  if ( qEnvironmentVariableIsEmpty( "QT_QPA_PLATFORM" ) )
+    qputenv( "QT_QPA_PLATFORM", "offscreen" );
+
+  QApplication app( argc, argv );
+
+  Options options;
+  if ( !parseOptions( app.arguments(), options ) ) {
+    printUsage();
+    return 1;
+  }
+
+  if ( options.mode == "paint" )
+    return benchPaint( options );
+  if ( options.mode == "traversal" )
+    return benchTraversal( options );
+  if ( options.mode == "watcher" )
+    return benchWatcher( options );
+  if ( options.mode == "partition" )
+    return benchPartition( options );
+
+  printUsage();
+  return 1;
+}
@@ -0,0 +1,340 @@
+#include "qstyle_loader.h"
+#include "qstyle_loader_p.h"
+
+#include <algorithm>
+#include <functional>
+
+#include <QUrl>
+#include <QLabel>
+#include <QFrame>
+#include <QSlider>
+#include <QThread>
+#include <QWidget>
+#include <QSpinBox>
+#include <QCheckBox>
+#include <QComboBox>
+#include <QGroupBox>
+#include <QLineEdit>
+#include <QTextEdit>
+#include <QFileInfo>
+#include <QTabWidget>
+#include <QTextStream>
+#include <QToolButton>
+#include <QPushButton>
+#include <QRadioButton>
+#include <QProgressBar>
+#include <QApplication>
+#include <QElapsedTimer>
+
+/*
+ *
+ * Replays a property change recording of QStyleUpdater.
+ *
+ * Usage: qstyle_replay [options] <recording> [style files and directories]
+ *
+ */
+
+static QTextStream out( stdout );
+
+struct Options
+{
+  QString     recording;
+  QStringList paths;
+  bool        fast;
+
+  Options()
+    : fast( false )
+  {
+
+  }
+};
+
+static void printUsage()
+{
+  out << "Usage: qstyle_replay [options] <recording> [style files and directories]\n"
+         "\n"
+         "Without style files, a sheet with one rule per recorded property value is used.\n"
+         "\n"
+         "Options:\n"
+         "  --fast         replay as fast as possible instead of the recorded timing\n";
+  out.flush();
+}
+
+static bool parseOptions(const QStringList &args, Options &options)
+{
+  for ( int i = 1; i < args.size(); ++i ) {
+    auto arg = args.at( i );
+    if ( arg == "--fast" )
+      options.fast = true;
+    else if ( arg.startsWith( "--" ) )
+      return false;
+    else if ( options.recording.isEmpty() )
+      options.recording = arg;
+    else
+      options.paths << arg;
+  }
+
+  return !options.recording.isEmpty();
+}
+
+static QString msecs(qint64 nsecs)
+{
+  return QString::number( nsecs / 1e6, 'f', 3 );
+}
+
+/*
+ *
+ * Widget tree
+ *
+ */
+
+class WidgetTree
+{
+  QHash<QString, QWidget*>                          m_paths;
+  QHash<QPair<QWidget*, QString>, QList<QWidget*>>  m_siblings;
+  QList<QWidget*>                                   m_roots;
+  int                                               m_substituted;
+public:
+  WidgetTree()
+    : m_substituted( 0 )
+  {
+
+  }
+  ~WidgetTree()
+  {
+    qDeleteAll( m_roots );
+  }
+
+  QList<QWidget*> roots() const
+  {
+    return m_roots;
+  }
+  int count() const
+  {
+    int result = 0;
+    for ( auto root: m_roots )
+      result += root->findChildren<QWidget*>().size() + 1;
+    return result;
+  }
+  int substituted() const
+  {
+    return m_substituted;
+  }
+
+  ///
+  /// \brief Widget of the recorded path, created with its ancestors when missing
+  ///
+  QWidget *widget(const QString &path)
+  {
+    auto it = m_paths.find( path );
+    if ( it != m_paths.end() )
+      return it.value();
+
+    QWidget *w = nullptr;
+    for ( auto &segment: path.split( '/' ) ) {
+      auto parts = segment.split( ':' );
+      if ( parts.size() != 3 )
+        return nullptr;
+
+      auto className = QUrl::fromPercentEncoding( parts.at( 0 ).toLatin1() );
+      auto objectName = QUrl::fromPercentEncoding( parts.at( 1 ).toLatin1() );
+      auto index = parts.at( 2 ).toInt();
+
+      // Siblings of the same class that were never recorded are created as well
+      auto &siblings = m_siblings[ qMakePair( w, className ) ];
+      while ( siblings.size() <= index ) {
+        auto sibling = create( className, w );
+        if ( !w )
+          m_roots << sibling;
+        siblings << sibling;
+      }
+
+      w = siblings.at( index );
+      w->setObjectName( objectName );
+    }
+
+    m_paths.insert( path, w );
+    return w;
+  }
+
+private:
+  QWidget *create(const QString &className, QWidget *parent)
+  {
+    static const QHash<QString, std::function<QWidget*(QWidget*)>> factory {
+      { "QWidget",      [](QWidget *p) -> QWidget* { return new QWidget( p ); } },
+      { "QFrame",       [](QWidget *p) -> QWidget* { return new QFrame( p ); } },
+      { "QLabel",       [](QWidget *p) -> QWidget* { return new QLabel( p ); } },
+      { "QPushButton",  [](QWidget *p) -> QWidget* { return new QPushButton( p ); } },
+      { "QToolButton",  [](QWidget *p) -> QWidget* { return new QToolButton( p ); } },
+      { "QCheckBox",    [](QWidget *p) -> QWidget* { return new QCheckBox( p ); } },
+      { "QRadioButton", [](QWidget *p) -> QWidget* { return new QRadioButton( p ); } },
+      { "QLineEdit",    [](QWidget *p) -> QWidget* { return new QLineEdit( p ); } },
+      { "QTextEdit",    [](QWidget *p) -> QWidget* { return new QTextEdit( p ); } },
+      { "QComboBox",    [](QWidget *p) -> QWidget* { return new QComboBox( p ); } },
+      { "QSpinBox",     [](QWidget *p) -> QWidget* { return new QSpinBox( p ); } },
+      { "QSlider",      [](QWidget *p) -> QWidget* { return new QSlider( p ); } },
+      { "QProgressBar", [](QWidget *p) -> QWidget* { return new QProgressBar( p ); } },
+      { "QGroupBox",    [](QWidget *p) -> QWidget* { return new QGroupBox( p ); } },
+      { "QTabWidget",   [](QWidget *p) -> QWidget* { return new QTabWidget( p ); } }
+    };
+
+    auto it = factory.find( className );
+    if ( it != factory.end() )
+      return it.value()( parent );
+
+    // Application classes are replaced with plain widgets
+    ++m_substituted;
+    return new QWidget( parent );
+  }
+};
+
+/*
+ *
+ * Replay
+ *
+ */
+
+static QString defaultStyle(const QList<QStyleRecordEvent> &events)
+{
+  QStringList rules;
+  QSet<QString> selectors;
+  for ( auto &event: events ) {
+    auto selector = QString( "*[%1=\"%2\"]" )
+        .arg( QString::fromUtf8( event.property ), event.value.toString().replace( '"', "\\\"" ) );
+    if ( selectors.contains( selector ) || selectors.size() >= 256 )
+      continue;
+
+    selectors.insert( selector );
+    rules << QString( "%1 { background-color: #%2; }" )
+             .arg( selector )
+             .arg( qHash( selector ) & 0xffffff, 6, 16, QChar( '0' ) );
+  }
+  return rules.join( '\n' );
+}
+
+static qint64 percentile(const QVector<qint64> &sorted, double fraction)
+{
+  if ( sorted.isEmpty() )
+    return 0;
+  return sorted.at( qMin( sorted.size() - 1, int( fraction * sorted.size() ) ) );
+}
+
+static int replay(const Options &options)
+{
+  QStyleRecordReader reader;
+  if ( !reader.open( options.recording ) ) {
+    out << QString( "error recording=\"%1\" reason=\"can not read the recording\"\n" ).arg( options.recording );
+    return 1;
+  }
+
+  QList<QStyleRecordEvent> events;
+  QStyleRecordEvent event;
+  while ( reader.read( event ) )
+    events << event;
+
+  // The whole tree exists before the replay starts
+  WidgetTree tree;
+  QVector<QWidget*> targets;
+  for ( auto &e: events )
+    targets << tree.widget( e.path );
+
+  QStyleLoader loader;
+  loader.setAutoReloadStyle( false );
+  for ( auto &path: options.paths ) {
+    if ( QFileInfo( path ).isDir() )
+      loader.addDirectory( path );
+    else
+      loader.addFile( path );
+  }
+  if ( options.paths.isEmpty() )
+    loader.addBuffer( "replay", defaultStyle( events ).toUtf8() );
+  loader.reloadAllStyle();
+
+  for ( auto root: tree.roots() ) {
+    auto updater = loader.addUpdater( root );
+    updater->setRefreshChildWidgets( true );
+    updater->setUpdateWithAllChanges( true );
+    root->show();
+  }
+  qApp->processEvents();
+
+  // Latency runs from the first unserved change of a widget to its repolish
+  QElapsedTimer clock;
+  QHash<QWidget*, qint64> pending;
+  QVector<qint64> latencies;
+  int repolished = 0;
+
+  auto connection = QObject::connect( &loader, &QStyleLoader::styleReloaded, [&](QStyleUpdater *, QWidget *widget) {
+    ++repolished;
+    auto it = pending.find( widget );
+    if ( it != pending.end() ) {
+      latencies << clock.nsecsElapsed() - it.value();
+      pending.erase( it );
+    }
+  });
+
+  clock.start();
+  for ( int i = 0; i < events.size(); ++i ) {
+    auto &e = events.at( i );
+    auto w = targets.at( i );
+    if ( !w )
+      continue;
+
+    while ( !options.fast && clock.nsecsElapsed() / 1000 < e.usecs ) {
+      qApp->processEvents();
+      if ( e.usecs - clock.nsecsElapsed() / 1000 > 2000 )
+        QThread::msleep( 1 );
+    }
+
+    if ( !pending.contains( w ) )
+      pending.insert( w, clock.nsecsElapsed() );
+    w->setProperty( e.property.constData(), e.value );
+
+    if ( options.fast )
+      qApp->processEvents();
+  }
+
+  // Changes that are still queued are flushed by the timer of the updaters
+  QElapsedTimer drain;
+  drain.start();
+  while ( !pending.isEmpty() && drain.elapsed() < 1000 ) {
+    qApp->processEvents();
+    QThread::msleep( 1 );
+  }
+  auto duration = clock.nsecsElapsed();
+  QObject::disconnect( connection );
+
+  std::sort( latencies.begin(), latencies.end() );
+  out << QString( "replay mode=%1 events=%2 widgets=%3 substituted=%4 duration_ms=%5 repolish=%6 unresolved=%7\n" )
+         .arg( options.fast ? "fast" : "real" )
+         .arg( events.size() )
+         .arg( tree.count() )
+         .arg( tree.substituted() )
+         .arg( msecs( duration ) )
+         .arg( repolished )
+         .arg( pending.size() );
+  out << QString( "latency p50_ms=%1 p90_ms=%2 p99_ms=%3 max_ms=%4\n" )
+         .arg( msecs( percentile( latencies, 0.5 ) ) )
+         .arg( msecs( percentile( latencies, 0.9 ) ) )
+         .arg( msecs( percentile( latencies, 0.99 ) ) )
+         .arg( msecs( latencies.isEmpty() ? 0 : latencies.last() ) );
+  out.flush();
+
+  return 0;
+}
+
+int main(int argc, char *argv[])
+{
+  if ( qEnvironmentVariableIsEmpty( "QT_QPA_PLATFORM" ) )
+    qputenv( "QT_QPA_PLATFORM", "offscreen" );
+
+  QApplication app( argc, argv );
+
+  Options options;
+  if ( !parseOptions( app.arguments(), options ) ) {
+    printUsage();
+    return 1;
+  }
+
+  return replay( options );
+}
@@ -0,0 +1,6 @@
+TEMPLATE    = subdirs
+
+SUBDIRS += \
+    qstyle_bench \
+    qss_profile \
+    qstyle_replay